@@ -25,6 +25,7 @@
 	#<base_scenario>base.tcl</base_scenario>
 	#<min_run>5</min_run>
 	#<max_run>5</max_run>
+	#<plan_file>plan</plan_file>
 	#<output_dir>savefile</output_dir>
 	#<savefile_dir>savefile</savefile_dir>
 	#<check_metrics>metrics_to_check</check_metrics>
@@ -334,10 +335,12 @@ def cmd2statmangle(cmd):
 ## Function that prints the usage informations and returns
 def print_usage():
 	# Print the usage informations
-	print "Usage: <run|test|stat|csv|fact> sim_desc.xml"
+	print "Usage: <run|batch|test|stat|csv|fact> sim_desc.xml"
 	print "Where:"
 	print "	run:	run simulation until the confidence level is reached"
 	print "		or the number of replics is beyond maximum"
+	print "	batch:	run the replics allocated in the plan file"
+	print "		(see factorial2kr -a and -p)"
 	print "	test:	print the simulation commands that will be run"
 	print "	stat:	collect the measures from the savefiles"
 	print "	csv:	print data in CSV format to a single file"
@@ -345,6 +348,55 @@ def print_usage():
 	exit()
 
 		
+## Function that runs the replications of a scenario into its savefile ##
+## If count is None, the replications go on until the confidence level
+## is reached or the number of replics is beyond maximum, otherwise count
+## more replications are run. Returns False on error.
+def run_scenario(simulation, item, mangle, count):
+	# Get the number of runs already saved
+	run = commands.getoutput(simulation.check_path+" -n "+simulation.savefile_dir+"/"+mangle)
+	if run == "err" or run == "no" :
+		run = "0"
+	run=int(run)
+	if count == None :
+		last=int(simulation.max_run)
+	else :
+		last=run+count
+	fifo=simulation.name+".fifo"
+	commands.getoutput("rm -f "+fifo)
+	# Create fifo
+	commands.getoutput("mkfifo "+fifo)
+	# Create the directory to save files
+	commands.getoutput("mkdir "+simulation.savefile_dir)
+	print mangle
+	start_time=time.time()
+	# Execute the runs
+	while run < last :
+		if count == None :
+			# Check the results
+			status=commands.getoutput( simulation.check_path+" "+simulation.savefile_dir+"/"+mangle+" -c "+simulation.check_conf_level+" -t "+simulation.check_th+" "+simulation.check_metrics )
+			if status == "ok" and run >= int(simulation.min_run) :
+				break
+			elif run > 0 and status == "err" :
+				print "Error in ",simulation.savefile_dir
+				return False
+		run=run+1
+		pid = os.fork()
+		# create the fifo to store data
+		if pid == 0:
+			commands.getoutput( "cat "+fifo+" >> "+simulation.savefile_dir+"/"+mangle )
+			sys.exit (0)
+		print "\t run ",run
+		# Launch the simulator
+		ns_cmd = simulation.ns_path+" "+simulation.base_scenario+" "+item+" -out "+fifo+" -run "+str(run)
+		if simulation.ns_output <> "":
+			ns_cmd += " > "+simulation.ns_output+"-out."+str(run)+" 2> "+simulation.ns_output+"-err."+str(run)
+		commands.getoutput (ns_cmd)
+		os.waitpid (pid, 0)
+	commands.getoutput("rm -f "+fifo)
+	print "Total scenario sim time ",time.time()-start_time," sec"
+	return True
+
 ## Main program ##
 def main():
 	global command
@@ -437,43 +489,37 @@ def main():
 			# Execute a scenario
 			mangle=final_mangle[index]
 			index=index+1
-			# Get the number of runs already saved
-			run = commands.getoutput(simulation.check_path+" -n "+simulation.savefile_dir+"/"+mangle)
-			if run == "err" or run == "no" :
-				run = "0"
-			run=int(run)
-			fifo=simulation.name+".fifo"
-			commands.getoutput("rm -f "+fifo)	
-			# Create fifo
-			commands.getoutput("mkfifo "+fifo)				
-			# Create the directory to save files
-			commands.getoutput("mkdir "+simulation.savefile_dir)
-			print mangle
-			start_time=time.time()
-			# Execute the runs
-			while int(run) < int(simulation.max_run) :
-				# Check the results
-				status=commands.getoutput( simulation.check_path+" "+simulation.savefile_dir+"/"+mangle+" -c "+simulation.check_conf_level+" -t "+simulation.check_th+" "+simulation.check_metrics )
-				if status == "ok" and int(run) >= int(simulation.min_run) :
-					break
-				elif int(run) > 0 and status == "err" :
-					print "Error in ",simulation.savefile_dir
-					return
-				run=run+1
-				pid = os.fork()
-				# create the fifo to store data
-				if pid == 0:
-					commands.getoutput( "cat "+fifo+" >> "+simulation.savefile_dir+"/"+mangle )
-					sys.exit (0)
-				print "\t run ",run
-				# Launch the simulator
-				ns_cmd = simulation.ns_path+" "+simulation.base_scenario+" "+item+" -out "+fifo+" -run "+str(run)
-				if simulation.ns_output <> "":
-					ns_cmd += " > "+simulation.ns_output+"-out."+str(run)+" 2> "+simulation.ns_output+"-err."+str(run)
-				commands.getoutput (ns_cmd)
-				os.waitpid (pid, 0)
-			commands.getoutput("rm -f "+fifo)				
-			print "Total scenario sim time ",time.time()-start_time," sec"
+			if not run_scenario(simulation, item, mangle, None) :
+				return
+	elif action == "batch":
+		# Some arguments are missing
+		if len(args) < 3:
+			print "Missing arguments..."
+			return
+		# Read the number of replics allocated to each scenario
+		plan = {}
+		try:
+			plan_file = open(simulation.plan_file,"r")
+		except IOError:
+			print "No plan file ",simulation.plan_file
+			return
+		for line in plan_file :
+			fields = line.split()
+			if len(fields) != 2 :
+				continue
+			try:
+				plan[fields[0]] = int(fields[1])
+			except ValueError:
+				continue
+		plan_file.close()
+		index=0
+		# Run the scenarios with replics allocated
+		for item in final_run :
+			mangle=final_mangle[index]
+			index=index+1
+			if not plan.has_key(mangle) :
+				continue
+			run_scenario(simulation, item, mangle, plan[mangle])
 	elif action == "stat":
 		# Some arguments are missing
 		if len(args) < 3:
@@ -0,0 +1,295 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: codec.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the encoding functions
+*/
+
+#include <codec.h>
+#include <string.h>
+
+namespace {
+
+//! Write a stream of bits, most significant bit first.
+class BitWriter
+{
+  //! Output buffer.
+  std::string& out;
+  //! Pending bits, left aligned.
+  uint64_t acc;
+  //! Number of pending bits.
+  unsigned int used;
+
+  //! Append the n most significant bytes of the pending bits.
+  void emit(unsigned int n) {
+    for (unsigned int i = 0; i < n; i++)
+      out.push_back((char)(acc >> (56 - 8 * i)));
+  }
+
+ public:
+  BitWriter(std::string& o)
+      : out(o)
+      , acc(0)
+      , used(0) {
+  }
+  //! Write the least significant bits of v, with 1 <= bits <= 64.
+  void put(uint64_t v, unsigned int bits) {
+    if (bits < 64)
+      v &= (1ULL << bits) - 1;
+    const unsigned int free = 64 - used;
+    if (bits < free) {
+      acc |= v << (free - bits);
+      used += bits;
+    } else {
+      const unsigned int rest = bits - free; // 0 <= rest < 64
+      acc |= v >> rest;
+      emit(8);
+      acc  = (rest == 0) ? 0 : v << (64 - rest);
+      used = rest;
+    }
+  }
+  //! Write the pending bits, padded to the byte boundary.
+  void flush() {
+    emit((used + 7) / 8);
+    acc  = 0;
+    used = 0;
+  }
+};
+
+//! Read a stream of bits, most significant bit first.
+class BitReader
+{
+  //! Next byte to be loaded.
+  const unsigned char* p;
+  //! End of the input buffer.
+  const unsigned char* end;
+  //! Loaded bits, left aligned.
+  uint64_t acc;
+  //! Number of loaded bits.
+  unsigned int avail;
+  //! Number of bits consumed.
+  uint64_t consumed;
+
+  //! Load up to 64 more bits. Return false if there are no more bytes.
+  bool refill() {
+    if (p == end)
+      return false;
+    acc   = 0;
+    avail = 0;
+    while (avail < 64 && p != end) {
+      acc |= (uint64_t)*p++ << (56 - avail);
+      avail += 8;
+    }
+    return true;
+  }
+
+ public:
+  BitReader(const char* in, const char* e)
+      : p((const unsigned char*)in)
+      , end((const unsigned char*)e)
+      , acc(0)
+      , avail(0)
+      , consumed(0) {
+  }
+  //! Read bits, with 1 <= bits <= 64. Return false on end of input.
+  bool get(uint64_t& v, unsigned int bits) {
+    consumed += bits;
+    if (bits <= avail) {
+      v = acc >> (64 - bits);
+      acc   = (bits == 64) ? 0 : acc << bits;
+      avail -= bits;
+      return true;
+    }
+    // take the remaining loaded bits, then the rest after a refill
+    const unsigned int first = avail;
+    const uint64_t     hi    = (first == 0) ? 0 : acc >> (64 - first);
+    const unsigned int rest  = bits - first;
+    if (!refill() || rest > avail)
+      return false;
+    v = (first == 0) ? 0 : hi << rest;
+    v |= acc >> (64 - rest);
+    acc = (rest == 64) ? 0 : acc << rest;
+    avail -= rest;
+    return true;
+  }
+  //! Return the number of bytes consumed, rounded up.
+  uint64_t bytes() const {
+    return (consumed + 7) / 8;
+  }
+};
+
+//! Return the bits of a sample.
+inline uint64_t toBits(sample_t x) {
+  uint64_t v;
+  memcpy(&v, &x, sizeof(v));
+  return v;
+}
+
+//! Return the sample with the given bits.
+inline sample_t fromBits(uint64_t v) {
+  sample_t x;
+  memcpy(&x, &v, sizeof(x));
+  return x;
+}
+
+} // namespace
+
+void Codec::putVarint(std::string& out, uint64_t x) {
+  while (x >= 0x80) {
+    out.push_back((char)(x | 0x80));
+    x >>= 7;
+  }
+  out.push_back((char)x);
+}
+
+const char* Codec::getVarint(const char* in, const char* end, uint64_t& x) {
+  x = 0;
+  for (unsigned int shift = 0; in != end && shift < 64; shift += 7) {
+    const unsigned char b = *in++;
+    x |= (uint64_t)(b & 0x7f) << shift;
+    if ((b & 0x80) == 0)
+      return in;
+  }
+  return 0;
+}
+
+void Codec::encodeDeltas(std::string&        out,
+                         const unsigned int* v,
+                         unsigned int        n) {
+  int64_t prev = 0;
+  for (unsigned int i = 0; i < n; i++) {
+    const int64_t delta = (int64_t)v[i] - prev;
+    prev                = v[i];
+    // zigzag: small negative numbers are mapped to small odd numbers
+    putVarint(out, ((uint64_t)delta << 1) ^ (uint64_t)(delta >> 63));
+  }
+}
+
+const char* Codec::decodeDeltas(const char*   in,
+                                const char*   end,
+                                unsigned int* v,
+                                unsigned      n) {
+  int64_t  prev = 0;
+  uint64_t z;
+  for (unsigned int i = 0; i < n; i++) {
+    in = getVarint(in, end, z);
+    if (in == 0)
+      return 0;
+    prev += (int64_t)(z >> 1) ^ -(int64_t)(z & 1);
+    v[i] = (unsigned int)prev;
+  }
+  return in;
+}
+
+void Codec::encodeSamples(std::string&    out,
+                          const sample_t* x,
+                          unsigned int    n) {
+  if (n == 0)
+    return;
+
+  BitWriter    w(out);
+  uint64_t     prev     = toBits(x[0]);
+  unsigned int leading  = 64; // window of the meaningful bits
+  unsigned int trailing = 0;  // (no window yet)
+
+  w.put(prev, 64);
+  for (unsigned int i = 1; i < n; i++) {
+    const uint64_t cur = toBits(x[i]);
+    const uint64_t xr  = cur ^ prev;
+    prev               = cur;
+
+    if (xr == 0) {
+      w.put(0, 1);
+      continue;
+    }
+
+    unsigned int lz = __builtin_clzll(xr);
+    unsigned int tz = __builtin_ctzll(xr);
+    if (lz > 31)
+      lz = 31; // must fit into 5 bits
+
+    if (leading < 64 && lz >= leading && tz >= trailing) {
+      // reuse the previous window
+      w.put(2, 2);
+      w.put(xr >> trailing, 64 - leading - trailing);
+    } else {
+      // new window, whose length 64 is encoded as 0
+      const unsigned int len = 64 - lz - tz;
+      w.put(3, 2);
+      w.put(lz, 5);
+      w.put(len & 63, 6);
+      w.put(xr >> tz, len);
+      leading  = lz;
+      trailing = tz;
+    }
+  }
+  w.flush();
+}
+
+const char* Codec::decodeSamples(const char* in,
+                                 const char* end,
+                                 sample_t*   x,
+                                 unsigned    n) {
+  if (n == 0)
+    return in;
+
+  BitReader    r(in, end);
+  uint64_t     prev;
+  uint64_t     v;
+  unsigned int leading  = 64;
+  unsigned int trailing = 0;
+
+  if (!r.get(prev, 64))
+    return 0;
+  x[0] = fromBits(prev);
+  for (unsigned int i = 1; i < n; i++) {
+    if (!r.get(v, 1))
+      return 0;
+    if (v == 1) {
+      if (!r.get(v, 1))
+        return 0;
+      if (v == 1) {
+        uint64_t lz, len;
+        if (!r.get(lz, 5) || !r.get(len, 6))
+          return 0;
+        if (len == 0)
+          len = 64;
+        if (lz + len > 64)
+          return 0;
+        leading  = lz;
+        trailing = 64 - lz - len;
+      } else if (leading == 64) {
+        return 0; // no window defined yet
+      }
+      if (!r.get(v, 64 - leading - trailing))
+        return 0;
+      prev ^= v << trailing;
+    }
+    x[i] = fromBits(prev);
+  }
+  return in + r.bytes();
+}
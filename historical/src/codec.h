@@ -0,0 +1,89 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: codec.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           compact encoding of integers and samples
+*/
+
+#ifndef __MEASURE_CODEC_H
+#define __MEASURE_CODEC_H
+
+#include <config.h>
+#include <object.h>
+
+#include <stdint.h>
+#include <string>
+
+//! Utility static class with the encoding functions of compressed blocks.
+/*!
+  Integers are encoded as base-128 varints, i.e., 7 bits per byte with
+  the most significant bit set in all bytes but the last one.
+  Sequences of integers are encoded as the zigzag varints of the
+  differences between consecutive values.
+
+  Samples are encoded as in the Gorilla time series database: the first
+  sample is stored as is, then each sample is XOR-ed with the previous
+  one, and only the meaningful bits of the result are stored:
+  - '0': same value as the previous sample
+  - '10' + bits: the meaningful bits fit into the previous window
+  - '11' + 5 bits leading zeros + 6 bits length + bits: new window
+
+  The decoding functions return the pointer to the first byte after
+  the decoded data, or NULL if the input is damaged.
+  */
+class Codec : public Object
+{
+ public:
+  //! Default constructor. Does nothing.
+  Codec()
+      : Object("Codec") {
+  }
+  //! Destructor. Does nothing.
+  ~Codec() {
+  }
+
+  //! Append a varint to a buffer.
+  static void putVarint(std::string& out, uint64_t x);
+  //! Decode a varint.
+  static const char* getVarint(const char* in, const char* end, uint64_t& x);
+
+  //! Append the delta encoding of an array of n integers to a buffer.
+  static void
+  encodeDeltas(std::string& out, const unsigned int* v, unsigned int n);
+  //! Decode an array of n integers.
+  static const char*
+  decodeDeltas(const char* in, const char* end, unsigned int* v, unsigned n);
+
+  //! Append the XOR encoding of an array of n samples to a buffer.
+  static void
+  encodeSamples(std::string& out, const sample_t* x, unsigned int n);
+  //! Decode an array of n samples.
+  static const char*
+  decodeSamples(const char* in, const char* end, sample_t* x, unsigned n);
+};
+
+#endif // __MEASURE_CODEC_H
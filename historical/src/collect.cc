@@ -0,0 +1,101 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+
+/**
+   project: measure
+   filename: collect.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           collect runs from many concurrent clients through a
+           Unix domain socket, or from one simulator through a shared
+           memory ring, until the confidence requirements are met
+*/
+
+#include <configuration.h>
+#include <input.h>
+#include <measure.h>
+#include <server.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+void printUsage() {
+  printf("usage: collect [-m] config_file name\n");
+  printf("collect runs from clients connected to the Unix domain socket\n");
+  printf("name, until the confidence requirements in config_file are met\n");
+  printf("-m          read runs from the shared memory ring name instead\n");
+  exit(0);
+}
+
+int main(int argc, char* argv[]) {
+  int  ch;           // for parsing arguments
+  bool ring = false; // use a shared memory ring instead of a socket
+
+  // parse command-line arguments
+  while ((ch = getopt(argc, argv, "hm")) != -1) {
+    switch (ch) {
+      case 'm':
+        ring = true;
+        break;
+      case 'h':
+      default:
+        printUsage();
+        break;
+    }
+  }
+
+  argc -= optind;
+  argv += optind;
+
+  if (argc != 2)
+    printUsage(); // does not return
+
+  try {
+    Configuration configuration;
+    Metrics       metrics;
+    configuration.parse(argv[0]);
+    Input input(configuration, metrics);
+    if (ring) {
+      input.loadRing(argv[1]);
+    } else {
+      Server server(configuration, input);
+      server.run(argv[1]);
+    }
+    printf("%u runs collected\n",
+           (unsigned int)input.getRunIdentifiers().size());
+
+  } catch (Object& obj) {
+    printf("Exception raised by the instance #%d of class %s. ",
+           obj.getId(),
+           obj.getName().c_str());
+    perror("Terminated\n");
+    exit(1);
+  }
+
+  return 0;
+}
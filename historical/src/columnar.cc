@@ -0,0 +1,466 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: columnar.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the ColumnarFile class
+*/
+
+#include <codec.h>
+#include <columnar.h>
+#include <string.h>
+
+#include <set>
+
+//! Magic number at the beginning of a columnar save file.
+static const char columnarMagic[8] = "F2KRCOL";
+//! Version of the columnar save file format.
+static const unsigned int columnarVersion = 2;
+
+//! Read a value from a stream. Throw obj on premature end of file.
+template <class T>
+static void readValue(std::istream& is, T& x, const Object& obj) {
+  is.read((char*)&x, sizeof(x));
+  if (is.eof())
+    throw obj;
+}
+
+//! Read an array of n values from a stream. Throw obj on premature EOF.
+template <class T>
+static void readArray(std::istream&      is,
+                      std::vector<T>&    v,
+                      unsigned long long n,
+                      const Object&      obj) {
+  v.resize(n);
+  if (n == 0)
+    return;
+  is.read((char*)&v[0], n * sizeof(T));
+  if (is.eof())
+    throw obj;
+}
+
+//! Append a value to a buffer.
+template <class T>
+static void append(std::string& buf, const T& x) {
+  buf.append((const char*)&x, sizeof(x));
+}
+
+//! Append a metric name, preceded by its length, to a buffer.
+static void appendName(std::string& buf, const std::string& name) {
+  const unsigned int len = name.size() + 1;
+  append(buf, len);
+  buf.append(name.c_str(), len);
+}
+
+bool ColumnarFile::detect(std::istream& is) {
+  char magic[sizeof(columnarMagic)];
+
+  const std::streampos pos = is.tellg();
+  is.read(magic, sizeof(magic));
+  const bool found = is.gcount() == sizeof(magic) &&
+                     memcmp(magic, columnarMagic, sizeof(magic)) == 0;
+  is.clear();
+  is.seekg(pos);
+  return found;
+}
+
+Column& ColumnarFile::getColumn(MetricType   type,
+                                const char*  name,
+                                unsigned int index,
+                                unsigned int bins,
+                                sample_t     binSize,
+                                sample_t     distLower) {
+  Column& c = (type == METRIC_AVG) ? avg[name][index] : dst[name][index];
+
+  if (c.desc.type == METRIC_NONE) {
+    c.desc.type      = type;
+    c.desc.name      = name;
+    c.desc.index     = index;
+    c.desc.bins      = bins;
+    c.desc.binSize   = binSize;
+    c.desc.distLower = distLower;
+    c.samples.resize(bins);
+  } else if (c.desc.bins != bins || c.desc.binSize != binSize ||
+             c.desc.distLower != distLower) {
+    // the bins of a distribution cannot change between runs
+    throw *this;
+  }
+  return c;
+}
+
+void ColumnarFile::importRuns(std::istream& is) {
+  std::set<unsigned int> known(runIdentifiers.begin(), runIdentifiers.end());
+
+  unsigned int id;        // run identifier
+  unsigned int num;       // number of metrics
+  unsigned int ndx;       // number of indices
+  unsigned int len;       // length of the strings (including trailing '\0')
+  unsigned int mid;       // metric ID
+  unsigned int bin;       // number of bins of distribution metrics
+  sample_t     sample;    // sample
+  sample_t     binSize;   // bin size of distribution metrics
+  sample_t     distLower; // lower bound of distribution metrics
+  char         metricName[MAX_METRIC_NAME];
+
+  for (;;) {
+    // a clean end of file is only allowed at the beginning of a run
+    is.read((char*)&id, sizeof(id));
+    if (is.eof())
+      break;
+
+    // runs with an identifier already imported are parsed and dropped
+    const bool         skip = known.count(id) == 1;
+    const unsigned int run  = runIdentifiers.size();
+    if (!skip) {
+      runIdentifiers.push_back(id);
+      known.insert(id);
+    }
+
+    // averaged metrics
+    readValue(is, num, *this);
+    for (unsigned int i = 0; i < num; i++) {
+      readValue(is, ndx, *this);
+      readValue(is, len, *this);
+      if (len > MAX_METRIC_NAME || len == 0)
+        throw *this;
+      is.read(metricName, len);
+      if (is.eof())
+        throw *this;
+      metricName[len - 1] = '\0';
+      for (unsigned int j = 0; j < ndx; j++) {
+        readValue(is, mid, *this);
+        readValue(is, sample, *this);
+        if (skip)
+          continue;
+        Column& c = getColumn(METRIC_AVG, metricName, mid, 1, 0, 0);
+        c.runs.push_back(run);
+        c.samples[0].push_back(sample);
+      }
+    }
+
+    // distribution metrics
+    readValue(is, num, *this);
+    for (unsigned int i = 0; i < num; i++) {
+      readValue(is, ndx, *this);
+      readValue(is, len, *this);
+      if (len > MAX_METRIC_NAME || len == 0)
+        throw *this;
+      is.read(metricName, len);
+      if (is.eof())
+        throw *this;
+      metricName[len - 1] = '\0';
+      readValue(is, binSize, *this);
+      readValue(is, distLower, *this);
+      readValue(is, bin, *this);
+      for (unsigned int j = 0; j < ndx; j++) {
+        readValue(is, mid, *this);
+        Column* c = 0;
+        if (!skip) {
+          c = &getColumn(METRIC_DIST, metricName, mid, bin, binSize, distLower);
+          c->runs.push_back(run);
+        }
+        for (unsigned int k = 0; k < bin; k++) {
+          readValue(is, sample, *this);
+          if (c != 0)
+            c->samples[k].push_back(sample);
+        }
+      }
+    }
+
+    // sketch metrics cannot be stored in columns
+    if (is.peek() == (SKETCH_MAGIC & 0xff)) {
+      unsigned int magic;
+      is.read((char*)&magic, sizeof(magic));
+      if (is.gcount() == sizeof(magic) && magic == SKETCH_MAGIC)
+        throw *this;
+      is.clear();
+      is.seekg(-is.gcount(), std::ios::cur);
+    }
+
+    // skip the checksum trailer, if any (it is not verified)
+    if (is.peek() == (CHECKSUM_MAGIC & 0xff)) {
+      unsigned int trailer[2];
+      is.read((char*)trailer, sizeof(trailer));
+      if (is.gcount() == sizeof(trailer) && trailer[0] == CHECKSUM_MAGIC)
+        continue;
+      is.clear();
+      is.seekg(-is.gcount(), std::ios::cur);
+    }
+    is.clear(); // in case peek() found the end of file
+  }
+}
+
+void ColumnarFile::exportRuns(std::ostream& os) const {
+  // all the columns, in the same order as the directory, with a cursor
+  // pointing to the next sample of each column to be exported
+  std::vector<const Column*> columns;
+  std::map<std::string, std::map<unsigned int, Column>>::const_iterator it;
+  std::map<unsigned int, Column>::const_iterator                        jt;
+  for (it = avg.begin(); it != avg.end(); ++it)
+    for (jt = it->second.begin(); jt != it->second.end(); ++jt)
+      columns.push_back(&jt->second);
+  const unsigned int numAvg = columns.size();
+  for (it = dst.begin(); it != dst.end(); ++it)
+    for (jt = it->second.begin(); jt != it->second.end(); ++jt)
+      columns.push_back(&jt->second);
+  std::vector<unsigned int> cursor(columns.size(), 0);
+
+  std::string run;  // whole run
+  std::string body; // body of the current metric type
+  std::string ndxs; // indices and samples of the current metric
+
+  for (unsigned int r = 0; r < runIdentifiers.size(); r++) {
+    run.clear();
+    append(run, runIdentifiers[r]);
+
+    // averaged metrics first, then distribution metrics
+    for (unsigned int type = 0; type < 2; type++) {
+      const unsigned int first = (type == 0) ? 0 : numAvg;
+      const unsigned int last  = (type == 0) ? numAvg : columns.size();
+      unsigned int       num   = 0; // number of metrics in this run
+
+      body.clear();
+      unsigned int i = first;
+      while (i < last) {
+        // group consecutive columns of the same metric, which in the
+        // case of distributions must also share the same bins
+        const ColumnDesc& d = columns[i]->desc;
+        unsigned int      n = 0; // number of indices
+        ndxs.clear();
+        for (; i < last; i++) {
+          const Column&     c = *columns[i];
+          const ColumnDesc& e = c.desc;
+          if (e.name != d.name || e.bins != d.bins ||
+              e.binSize != d.binSize || e.distLower != d.distLower)
+            break;
+          for (; cursor[i] < c.runs.size() && c.runs[cursor[i]] == r;
+               cursor[i]++) {
+            append(ndxs, e.index);
+            for (unsigned int k = 0; k < e.bins; k++)
+              append(ndxs, c.get(cursor[i], k));
+            n++;
+          }
+        }
+        if (n == 0)
+          continue;
+        num++;
+        append(body, n);
+        appendName(body, d.name);
+        if (type == 1) {
+          append(body, d.binSize);
+          append(body, d.distLower);
+          append(body, d.bins);
+        }
+        body += ndxs;
+      }
+      append(run, num);
+      run += body;
+    }
+    os.write(run.data(), run.size());
+  }
+}
+
+void ColumnarFile::write(std::ostream& os) {
+  // build the directory
+  directory.clear();
+  std::vector<const Column*> columns;
+  for (unsigned int type = 0; type < 2; type++) {
+    std::map<std::string, std::map<unsigned int, Column>>& m =
+        (type == 0) ? avg : dst;
+    std::map<std::string, std::map<unsigned int, Column>>::iterator it;
+    std::map<unsigned int, Column>::iterator                        jt;
+    for (it = m.begin(); it != m.end(); ++it) {
+      for (jt = it->second.begin(); jt != it->second.end(); ++jt) {
+        jt->second.desc.size = jt->second.runs.size();
+        directory.push_back(jt->second.desc);
+        columns.push_back(&jt->second);
+      }
+    }
+  }
+
+  // encode the blocks in advance, since their size is needed in the header
+  std::vector<std::string> blocks(compressed ? columns.size() : 0);
+  for (unsigned int i = 0; i < blocks.size(); i++) {
+    const Column& c = *columns[i]; // alias
+    std::string   data;
+    if (!c.runs.empty()) {
+      Codec::encodeDeltas(data, &c.runs[0], c.runs.size());
+      for (unsigned int k = 0; k < c.desc.bins; k++)
+        Codec::encodeSamples(data, &c.samples[k][0], c.samples[k].size());
+    }
+    append(blocks[i], (unsigned long long)data.size());
+    blocks[i] += data;
+  }
+
+  // header
+  std::string hdr;
+  hdr.append(columnarMagic, sizeof(columnarMagic));
+  append(hdr, columnarVersion);
+  append(hdr, (unsigned int)(compressed ? COLUMNAR_COMPRESSED : 0));
+  append(hdr, (unsigned int)runIdentifiers.size());
+  for (unsigned int i = 0; i < runIdentifiers.size(); i++)
+    append(hdr, runIdentifiers[i]);
+  append(hdr, (unsigned int)directory.size());
+
+  // compute the size of the directory to set the offsets of the blocks
+  unsigned long long offset = hdr.size();
+  for (unsigned int i = 0; i < directory.size(); i++)
+    offset += 5 * sizeof(unsigned int) + directory[i].name.size() + 1 +
+              2 * sizeof(sample_t) + sizeof(offset);
+  for (unsigned int i = 0; i < directory.size(); i++) {
+    ColumnDesc& d = directory[i]; // alias
+    d.offset      = offset;
+    if (compressed)
+      offset += blocks[i].size();
+    else
+      offset += d.size * (sizeof(unsigned int) + d.bins * sizeof(sample_t));
+
+    append(hdr, (unsigned int)d.type);
+    appendName(hdr, d.name);
+    append(hdr, d.index);
+    append(hdr, d.size);
+    append(hdr, d.bins);
+    append(hdr, d.binSize);
+    append(hdr, d.distLower);
+    append(hdr, d.offset);
+  }
+  os.write(hdr.data(), hdr.size());
+
+  // blocks
+  for (unsigned int i = 0; i < columns.size(); i++) {
+    if (compressed) {
+      os.write(blocks[i].data(), blocks[i].size());
+      continue;
+    }
+    const Column& c = *columns[i]; // alias
+    if (c.runs.empty())
+      continue;
+    os.write((const char*)&c.runs[0], c.runs.size() * sizeof(unsigned int));
+    for (unsigned int k = 0; k < c.desc.bins; k++)
+      os.write((const char*)&c.samples[k][0],
+               c.samples[k].size() * sizeof(sample_t));
+  }
+  os.flush();
+}
+
+void ColumnarFile::readDirectory(std::istream& is) {
+  char         magic[sizeof(columnarMagic)];
+  unsigned int version;
+  unsigned int flags;
+  unsigned int num;
+  unsigned int len;
+  unsigned int type;
+  char         metricName[MAX_METRIC_NAME];
+
+  is.read(magic, sizeof(magic));
+  if (is.eof() || memcmp(magic, columnarMagic, sizeof(magic)) != 0)
+    throw *this;
+  readValue(is, version, *this);
+  readValue(is, flags, *this);
+  if (version != columnarVersion || (flags & ~COLUMNAR_COMPRESSED) != 0)
+    throw *this;
+  compressed = (flags & COLUMNAR_COMPRESSED) != 0;
+
+  readValue(is, num, *this);
+  readArray(is, runIdentifiers, num, *this);
+
+  readValue(is, num, *this);
+  directory.resize(num);
+  for (unsigned int i = 0; i < num; i++) {
+    ColumnDesc& d = directory[i]; // alias
+    readValue(is, type, *this);
+    if (type != METRIC_AVG && type != METRIC_DIST)
+      throw *this;
+    d.type = (MetricType)type;
+    readValue(is, len, *this);
+    if (len > MAX_METRIC_NAME || len == 0)
+      throw *this;
+    is.read(metricName, len);
+    if (is.eof())
+      throw *this;
+    metricName[len - 1] = '\0';
+    d.name              = metricName;
+    readValue(is, d.index, *this);
+    readValue(is, d.size, *this);
+    readValue(is, d.bins, *this);
+    readValue(is, d.binSize, *this);
+    readValue(is, d.distLower, *this);
+    readValue(is, d.offset, *this);
+  }
+}
+
+void ColumnarFile::readColumn(std::istream& is,
+                              unsigned int  i,
+                              Column&       c) const {
+  if (i >= directory.size())
+    throw *this;
+
+  c.desc = directory[i];
+  is.seekg(c.desc.offset);
+
+  if (compressed) {
+    // read the whole block at once, then decode it
+    unsigned long long size;
+    std::vector<char>  data;
+    readValue(is, size, *this);
+    readArray(is, data, size, *this);
+    const char* p   = data.empty() ? 0 : &data[0];
+    const char* end = p + data.size();
+
+    c.runs.resize(c.desc.size);
+    c.samples.resize(c.desc.bins);
+    if (c.desc.size > 0) {
+      p = Codec::decodeDeltas(p, end, &c.runs[0], c.desc.size);
+      for (unsigned int k = 0; k < c.desc.bins && p != 0; k++) {
+        c.samples[k].resize(c.desc.size);
+        p = Codec::decodeSamples(p, end, &c.samples[k][0], c.desc.size);
+      }
+      if (p == 0)
+        throw *this;
+    }
+  } else {
+    readArray(is, c.runs, c.desc.size, *this);
+    c.samples.resize(c.desc.bins);
+    for (unsigned int k = 0; k < c.desc.bins; k++)
+      readArray(is, c.samples[k], c.desc.size, *this);
+  }
+
+  for (unsigned int j = 0; j < c.desc.size; j++)
+    if (c.runs[j] >= runIdentifiers.size())
+      throw *this;
+}
+
+void ColumnarFile::read(std::istream& is) {
+  avg.clear();
+  dst.clear();
+  readDirectory(is);
+  for (unsigned int i = 0; i < directory.size(); i++) {
+    const ColumnDesc& d = directory[i]; // alias
+    Column& c = (d.type == METRIC_AVG) ? avg[d.name][d.index]
+                                       : dst[d.name][d.index];
+    readColumn(is, i, c);
+  }
+}
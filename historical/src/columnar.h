@@ -0,0 +1,216 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: columnar.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           columnar save file format (version 2)
+*/
+
+/*
+        columnar save file format (version 2)
+
+        The samples of each (metric, index) pair are stored in a single
+        block, so that a metric can be loaded without touching the others.
+        Native byte order, as in the run protocol of input.h.
+
+        U64 = unsigned 64-bit integer
+
+        type  data
+        CHR   magic number "F2KRCOL" (8 bytes, including '\0')
+        UIN   format version (= 2)
+        UIN   flags (COLUMNAR_COMPRESSED if the blocks are compressed)
+        UIN   no. of runs = R
+        UIN   run identifiers, in file order                         -| R times
+        UIN   no. of blocks = B
+ |-UIN   metric type (METRIC_AVG or METRIC_DIST)
+ | UIN   length of the name of the metric = len (including '\0')
+ | CHR   name of the metric, of length len
+ | UIN   index of the metric
+b| UIN   no. of samples in the block = n
+ | UIN   no. of bins = bb (1 for averaged metrics)
+ | DBL   bin size (0 for averaged metrics)
+ | DBL   lower bound of the distribution (0 for averaged metrics)
+ |-U64   offset of the block data from the beginning of the file
+        then, for each block b=0,1,..,B-1 at the given offset:
+        UIN   position in the run identifiers array of each sample   -| n times
+        DBL   sample of the first bin, one per run                   -| n times
+        DBL   ..                                                       bb times
+        DBL   sample of the last bin, one per run                    -| n times
+
+        Blocks are sorted by type, then name, then index. Within a block,
+        the samples appear in the same order as the runs in the file.
+
+        If the COLUMNAR_COMPRESSED flag is set, each block at the given
+        offset is encoded as follows (see codec.h):
+        U64   size of the encoded block in bytes
+        VAR   delta-encoded run identifier positions (n varints)
+        BIT   XOR-encoded samples of the first bin (n samples)
+        BIT   ..                                                       bb times
+        BIT   XOR-encoded samples of the last bin (n samples)
+        where the XOR-encoded samples of each bin start at a byte boundary.
+*/
+
+#ifndef __MEASURE_COLUMNAR_H
+#define __MEASURE_COLUMNAR_H
+
+#include <config.h>
+#include <object.h>
+
+#include <map>
+#include <vector>
+
+#include <iostream>
+#include <string>
+
+//! Flag of columnar save files whose blocks are compressed.
+#define COLUMNAR_COMPRESSED 0x1
+
+//! Descriptor of a block in a columnar save file.
+struct ColumnDesc {
+ public:
+  //! Metric type.
+  MetricType type;
+  //! Metric name.
+  std::string name;
+  //! Metric index.
+  unsigned int index;
+  //! Number of samples (i.e., runs) in the block.
+  unsigned int size;
+  //! Number of bins. Always 1 for averaged metrics.
+  unsigned int bins;
+  //! Bin size. Only meaningful for distribution metrics.
+  sample_t binSize;
+  //! Distribution lower bound. Only meaningful for distribution metrics.
+  sample_t distLower;
+  //! Offset of the block data within the file.
+  unsigned long long offset;
+
+  //! Create an empty descriptor.
+  ColumnDesc()
+      : type(METRIC_NONE)
+      , index(0)
+      , size(0)
+      , bins(1)
+      , binSize(0)
+      , distLower(0)
+      , offset(0) {
+  }
+};
+
+//! Samples of one (metric, index) pair across all the runs.
+struct Column {
+ public:
+  //! Block descriptor.
+  ColumnDesc desc;
+  //! Position of each sample's run in the array of run identifiers.
+  std::vector<unsigned int> runs;
+  //! Samples, one contiguous array per bin with one value per run.
+  std::vector<std::vector<sample_t>> samples;
+
+  //! Return the sample of a given bin in the i-th run of the block.
+  sample_t get(unsigned int i, unsigned int bin) const {
+    return samples[bin][i];
+  }
+};
+
+//! Columnar save file, with conversion from/to the run protocol.
+class ColumnarFile : public Object
+{
+  //! Run identifiers, in file order.
+  std::vector<unsigned int> runIdentifiers;
+  //! Blocks of averaged metrics, indexed by name and metric index.
+  std::map<std::string, std::map<unsigned int, Column>> avg;
+  //! Blocks of distribution metrics, indexed by name and metric index.
+  std::map<std::string, std::map<unsigned int, Column>> dst;
+  //! Block directory, filled by readDirectory() or write().
+  std::vector<ColumnDesc> directory;
+  //! True if the blocks are compressed.
+  bool compressed;
+
+  //! Return the column of a metric, creating it if needed.
+  Column& getColumn(MetricType   type,
+                    const char*  name,
+                    unsigned int index,
+                    unsigned int bins,
+                    sample_t     binSize,
+                    sample_t     distLower);
+
+ public:
+  //! Create an empty columnar file.
+  ColumnarFile()
+      : Object("ColumnarFile")
+      , compressed(false) {
+  }
+  //! Do nothing.
+  ~ColumnarFile() {
+  }
+
+  //! Return true if the stream contains a columnar save file.
+  /*!
+    The get pointer of the stream is left unchanged.
+    */
+  static bool detect(std::istream& is);
+
+  //! Append all the runs read from a stream in the run protocol format.
+  /*!
+    Runs with an identifier already imported are skipped. An exception
+    is thrown if the input is damaged, if the bins of a distribution
+    metric change between runs, or if a run contains sketch metrics,
+    which are not supported by the columnar format.
+    */
+  void importRuns(std::istream& is);
+  //! Write all the runs to a stream in the run protocol format.
+  void exportRuns(std::ostream& os) const;
+
+  //! Write the columnar file to a stream.
+  void write(std::ostream& os);
+  //! Read the whole columnar file from a stream.
+  void read(std::istream& is);
+
+  //! Read the header and the block directory only.
+  void readDirectory(std::istream& is);
+  //! Read the data of the i-th block in the directory.
+  void readColumn(std::istream& is, unsigned int i, Column& c) const;
+
+  //! Set whether the blocks are compressed by write().
+  void setCompressed(bool c) {
+    compressed = c;
+  }
+  //! Return true if the blocks are compressed.
+  bool getCompressed() const {
+    return compressed;
+  }
+  //! Return the run identifiers, in file order.
+  const std::vector<unsigned int>& getRunIdentifiers() const {
+    return runIdentifiers;
+  }
+  //! Return the block directory.
+  const std::vector<ColumnDesc>& getDirectory() const {
+    return directory;
+  }
+};
+
+#endif // __MEASURE_COLUMNAR_H
@@ -35,8 +35,8 @@
 //! Sample type defined as a double.
 typedef double sample_t;
 
-//! Metric type: averaged or distribution.
-enum MetricType { METRIC_AVG, METRIC_DIST, METRIC_NONE };
+//! Metric type: averaged, distribution or sketch.
+enum MetricType { METRIC_AVG, METRIC_DIST, METRIC_SKETCH, METRIC_NONE };
 
 //! Maximum metric name size (including trailing '\0')
 #define MAX_METRIC_NAME 1024
@@ -47,7 +47,73 @@ enum MetricType { METRIC_AVG, METRIC_DIST, METRIC_NONE };
 //! Reallocates vector sizes in chunk of this size.
 #define VECTOR_CHUNK_SIZE 1024
 
+//! Ids below this value are always kept in the dense table of AvgMeasure
+#define DENSE_MIN_SIZE 1024
+
+//! Minimum number of bins of a distribution to be stored in sparse form
+#define SPARSE_MIN_BINS 64
+
+//! Default relative accuracy of the quantiles of a Sketch
+#define SKETCH_ACCURACY 0.01
+
+//! Minimum relative accuracy of the quantiles of a Sketch
+#define SKETCH_MIN_ACCURACY 1e-6
+
+//! Maximum number of buckets of a Sketch, the lowest are merged beyond
+#define SKETCH_MAX_BUCKETS 2048
+
+//! Minimum number of populations handled by each thread of a Parallel loop
+#define PARALLEL_MIN_ITEMS 1024
+
+//! Number of samples in each chunk of a SampleStore
+#define SAMPLE_CHUNK_SIZE 4096
+
+//! Initial size of the first chunk of a SampleStore, a power of two
+#define SAMPLE_FIRST_CHUNK_SIZE 16
+
+//! Maximum number of free chunks kept for reuse by the SampleStore
+#define SAMPLE_POOL_SIZE 1024
+
 //! Buffer size when copying a file
 #define COPY_BUFFER_SIZE 65536
 
+//! Maximum number of runs waiting to be appended to the save file
+#define SAVE_QUEUE_SIZE 64
+
+//! Buffer size when reading inotify events in watch mode
+#define WATCH_BUFFER_SIZE 4096
+
+//! Maximum number of events returned by epoll at once by the server
+#define SERVER_MAX_EVENTS 64
+
+//! Default size of the data area of a shared memory ring, in bytes
+#define SHM_RING_SIZE (16 * 1024 * 1024)
+
+//! Length of the padding records of a shared memory ring
+#define SHM_RING_PAD 0xffffffff
+
+//! Magic string at the beginning of a shared memory ring
+#define SHM_RING_MAGIC "F2KRSHM"
+
+//! Magic number of the hello of the compact communication protocol
+#define PROTOCOL_MAGIC 0x32524b46
+
+//! Version of the compact communication protocol
+#define PROTOCOL_VERSION 2
+
+//! Magic number of the checksum trailer of a run (in the save file).
+#define CHECKSUM_MAGIC 0xc5c32c1a
+
+//! Magic number of the sketch metrics of a run.
+#define SKETCH_MAGIC 0x5e7c4b2d
+
+//! Magic string at the beginning of a snapshot file
+#define SNAPSHOT_MAGIC "F2KRSNP"
+
+//! Version of the snapshot file format
+#define SNAPSHOT_VERSION 6
+
+//! Number of bytes at the end of the save file covered by a snapshot
+#define SNAPSHOT_TAIL 4096
+
 #endif // __MEASURE_CONFIG_H
@@ -30,6 +30,10 @@
 */
 
 #include <configuration.h>
+#include <crc32c.h>
+
+#include <climits>
+#include <sstream>
 
 void Configuration::insert(std::string          s,
                            unsigned int         id,
@@ -40,6 +44,11 @@ void Configuration::insert(std::string          s,
     v.resize(id + 1);
 
   v[id] = dsc;
+  if (dsc.stream)
+    streamed[s].insert(id);
+  else if (streamed.count(s) == 1 && streamed[s].erase(id) == 1 &&
+           streamed[s].empty())
+    streamed.erase(s);
 }
 
 void Configuration::insert(std::string          s,
@@ -58,15 +67,25 @@ void Configuration::insert(std::string          s,
   else if (what == "mean")
     v[id].mean = dsc;
   else if (what == "median")
-    v[id].median = dsc;
-  else if (what == "q95")
-    v[id].percentile95 = dsc;
-  else if (what == "q99")
-    v[id].percentile99 = dsc;
-  else
+    insertPercentile(s, id, 50, dsc);
+  else if (what.size() > 1 && what[0] == 'q') {
+    char*        end; // first character after the percentile level
+    const double level = strtod(what.c_str() + 1, &end);
+    if (*end != '\0' || !(level > 0 && level < 100))
+      throw *this;
+    insertPercentile(s, id, level, dsc);
+  } else
     throw *this;
 }
 
+void Configuration::insertPercentile(std::string          s,
+                                     unsigned int         id,
+                                     double               level,
+                                     const MetricDescAvg& dsc) {
+  dst[s][id].percentiles[level] = dsc;
+  percentiles[s].insert(level);
+}
+
 std::string Configuration::getNextWord(std::istream& is, bool required) {
   std::string word; // buffer
 
@@ -113,6 +132,40 @@ void Configuration::parse(std::string inputFileName) {
       headerName = getNextWord(is, true);
     } else if (word == "trailer") {
       trailerName = getNextWord(is, true);
+    } else if (word == "checksum") {
+      checksum = true;
+    } else if (word == "sync") {
+      // run: after each run, stop: only at the end, N: every N runs
+      word = getNextWord(is, true);
+      if (word == "run") {
+        syncPolicy = SYNC_RUN;
+      } else if (word == "stop") {
+        syncPolicy = SYNC_STOP;
+      } else {
+        syncPolicy = SYNC_EVERY;
+        syncEvery  = atoi(word.c_str());
+        if (syncEvery == 0)
+          throw *this;
+      }
+    } else if (word == "lag") {
+      // 0: the statistics are computed before replying to each run
+      word = getNextWord(is, true);
+
+      // a non-negative integer, which atoi would not check
+      char*      last; // first character not converted
+      const long n = strtol(word.c_str(), &last, 10);
+      if (last == word.c_str() || *last != '\0' || n < 0 || n >= INT_MAX)
+        throw *this;
+      lag = n;
+    } else if (word == "snapshot") {
+      // N: write a snapshot of the measures every N runs, and on stop
+      word          = getNextWord(is, true);
+      snapshotEvery = atoi(word.c_str());
+      if (snapshotEvery == 0)
+        throw *this;
+    } else if (word == "stopfile") {
+      // created by another process, e.g., factorial2kr -s
+      stopFileName = getNextWord(is, true);
     } else if (word == "minruns") {
       word       = getNextWord(is, true);
       minReplics = atoi(word.c_str());
@@ -140,6 +193,11 @@ void Configuration::parse(std::string inputFileName) {
         avg.threshold = atof(word.c_str());
         word          = getNextWord(is, false);
       }
+      // keep only the moments of the samples, not the samples
+      if (word == "stream") {
+        avg.stream = true;
+        word       = getNextWord(is, false);
+      }
       // parse error if neither out nor check words are found
       if (avg.output == false && avg.check == false)
         throw *this;
@@ -194,6 +252,43 @@ void Configuration::parse(std::string inputFileName) {
   is.close();
 }
 
+unsigned int Configuration::getRelevantChecksum() const {
+  std::string relevant; // type, name and index of the relevant metrics
+
+  std::map<std::string, std::vector<MetricDescAvg>>::const_iterator it;
+  for (it = avg.begin(); it != avg.end(); it++) {
+    for (unsigned int i = 0; i < it->second.size(); i++) {
+      if (it->second[i].isRelevant()) {
+        // the samples kept depend on the streaming mode, too
+        relevant.append((it->second[i].stream ? "t" : "s") + it->first +
+                        '\0');
+        relevant.append((const char*)&i, sizeof(i));
+      }
+    }
+  }
+
+  std::map<std::string, std::vector<MetricDescDst>>::const_iterator jt;
+  for (jt = dst.begin(); jt != dst.end(); jt++) {
+    for (unsigned int i = 0; i < jt->second.size(); i++) {
+      if (jt->second[i].isRelevant()) {
+        relevant.append("d" + jt->first + '\0');
+        relevant.append((const char*)&i, sizeof(i));
+      }
+    }
+  }
+
+  // the derived statistics depend on the percentile levels, too
+  std::map<std::string, std::set<double>>::const_iterator kt;
+  for (kt = percentiles.begin(); kt != percentiles.end(); kt++) {
+    relevant.append("q" + kt->first + '\0');
+    std::set<double>::const_iterator lt;
+    for (lt = kt->second.begin(); lt != kt->second.end(); lt++)
+      relevant.append((const char*)&*lt, sizeof(*lt));
+  }
+
+  return Crc32c::update(0, relevant.data(), relevant.size());
+}
+
 void Configuration::dump(std::ostream& os) {
   // print general configuration
   os << "save:    " << outputFileName << '\n';
@@ -201,6 +296,17 @@ void Configuration::dump(std::ostream& os) {
   os << "trailer: " << trailerName << '\n';
   os << "minruns: " << minReplics << '\n';
   os << "maxruns: " << maxReplics << '\n';
+  os << "checksum: " << (checksum ? "yes" : "no") << '\n';
+  os << "sync:    ";
+  if (syncPolicy == SYNC_RUN)
+    os << "run\n";
+  else if (syncPolicy == SYNC_STOP)
+    os << "stop\n";
+  else
+    os << syncEvery << '\n';
+  os << "lag:     " << lag << '\n';
+  os << "snapshot: " << snapshotEvery << '\n';
+  os << "stopfile: " << stopFileName << '\n';
 
   // print averaged metrics configuration
   std::map<std::string, std::vector<MetricDescAvg>>::iterator it;
@@ -220,6 +326,8 @@ void Configuration::dump(std::ostream& os) {
           os << m.CL << ';' << m.threshold;
         else
           os << ';';
+        if (m.stream == true)
+          os << ";stream";
         os << '\n';
       }
     }
@@ -230,34 +338,29 @@ void Configuration::dump(std::ostream& os) {
 
   for (jt = dst.begin(); jt != dst.end(); jt++) {
     for (unsigned int i = 0; i < jt->second.size(); i++) {
-      for (unsigned int j = 0; j < 6; j++) {
-        MetricDescAvg* m = nullptr;
-
-        // demux the current submetric
-        if (j == 0)
-          m = &jt->second[i].pmf;
-        else if (j == 1)
-          m = &jt->second[i].cdf;
-        else if (j == 2)
-          m = &jt->second[i].mean;
-        else if (j == 3)
-          m = &jt->second[i].median;
-        else if (j == 4)
-          m = &jt->second[i].percentile95;
-        else if (j == 5)
-          m = &jt->second[i].percentile99;
-
-        if (m != nullptr and m->relevant == true) {
-          os << "d;" << jt->first << ';' << i << ';'
-             << ((j == 0) ?
-                     "pmf" :
-                     (j == 1) ?
-                     "cdf" :
-                     (j == 2) ?
-                     "mean" :
-                     (j == 3) ? "median" :
-                                (j == 4) ? "q95" : (j == 5) ? "q99" : "unknown")
-             << ';' << ((m->output == true) ? '1' : '0') << ';';
+      MetricDescDst& d = jt->second[i]; // alias
+
+      // demux the submetrics, then the percentiles in increasing order
+      std::vector<std::pair<std::string, MetricDescAvg*>> sub;
+      sub.push_back(std::make_pair(std::string("pmf"), &d.pmf));
+      sub.push_back(std::make_pair(std::string("cdf"), &d.cdf));
+      sub.push_back(std::make_pair(std::string("mean"), &d.mean));
+      std::map<double, MetricDescAvg>::iterator kt;
+      for (kt = d.percentiles.begin(); kt != d.percentiles.end(); kt++) {
+        std::stringstream what;
+        if (kt->first == 50)
+          what << "median";
+        else
+          what << 'q' << kt->first;
+        sub.push_back(std::make_pair(what.str(), &kt->second));
+      }
+
+      for (unsigned int j = 0; j < sub.size(); j++) {
+        MetricDescAvg* m = sub[j].second;
+
+        if (m->relevant == true) {
+          os << "d;" << jt->first << ';' << i << ';' << sub[j].first << ';'
+             << ((m->output == true) ? '1' : '0') << ';';
           if (m->output == true)
             os << m->outCL << ';';
           else
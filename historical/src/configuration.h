@@ -35,6 +35,7 @@
 #include <config.h>
 #include <measure.h>
 #include <object.h>
+#include <savewriter.h>
 
 #include <map>
 #include <set>
@@ -60,12 +61,18 @@ struct MetricDescAvg {
   double CL;
   //! Confidence threshold. Only meaningful if check == true.
   double threshold;
+  //! True if only the moments of the samples are kept (averaged metrics).
+  bool stream;
 
   //! Create by default a non-relevant metric descriptor.
   MetricDescAvg()
       : relevant(false)
       , output(false)
-      , check(false) {
+      , check(false)
+      , outCL(0)
+      , CL(0)
+      , threshold(0)
+      , stream(false) {
   }
   //! Return true if this metric is relevant.
   bool isRelevant() const {
@@ -74,6 +81,9 @@ struct MetricDescAvg {
 };
 
 //! Descriptor for distribution metrics.
+/*!
+  Also used for sketch metrics, for which the pmf and cdf do not apply.
+  */
 struct MetricDescDst {
  public:
   //! Descriptor for the Probability Mass Function.
@@ -82,22 +92,21 @@ struct MetricDescDst {
   MetricDescAvg cdf;
   //! Descriptor for the mean value.
   MetricDescAvg mean;
-  //! Descriptor for he median value.
-  MetricDescAvg median;
-  //! Descriptor for the 95th percentile value.
-  MetricDescAvg percentile95;
-  //! Descriptor for the 99th percentile value.
-  MetricDescAvg percentile99;
+  //! Descriptors for the percentiles, by level (e.g. 50 for the median).
+  std::map<double, MetricDescAvg> percentiles;
 
   //! Create by default a non-relevent metric descriptor.
   MetricDescDst() {
   }
   //! Return true if this metric is relevant.
   bool isRelevant() const {
-    if (pmf.relevant == true || cdf.relevant == true || mean.relevant == true ||
-        median.relevant == true || percentile95.relevant == true ||
-        percentile99.relevant == true)
+    if (pmf.relevant == true || cdf.relevant == true || mean.relevant == true)
       return true;
+    std::map<double, MetricDescAvg>::const_iterator it;
+    for (it = percentiles.begin(); it != percentiles.end(); ++it) {
+      if (it->second.relevant == true)
+        return true;
+    }
     return false;
   }
 };
@@ -115,10 +124,26 @@ class Configuration : public Object
   std::string headerName;
   //! Trailer file name.
   std::string trailerName;
+  //! True if a checksum trailer is appended to the runs in the save file.
+  bool checksum;
+  //! Synchronization policy of the save file.
+  SyncPolicy syncPolicy;
+  //! Number of runs between two synchronizations, with SYNC_EVERY.
+  unsigned int syncEvery;
+  //! Number of runs which may be accepted after the stop decision.
+  unsigned int lag;
+  //! Number of runs between two snapshots. No snapshots => 0.
+  unsigned int snapshotEvery;
+  //! File whose existence stops the simulation. None => empty.
+  std::string stopFileName;
   //! Descriptors for averaged metrics.
   std::map<std::string, std::vector<MetricDescAvg>> avg;
   //! Descriptors for distribution metrics.
   std::map<std::string, std::vector<MetricDescDst>> dst;
+  //! Percentile levels of the distribution metrics, for any index.
+  std::map<std::string, std::set<double>> percentiles;
+  //! Indices of the averaged metrics whose samples are not kept.
+  std::map<std::string, std::set<unsigned int>> streamed;
 
   //! Insert an averaged metric descriptor.
   /*!
@@ -128,12 +153,19 @@ class Configuration : public Object
   //! Insert a distribution metric descriptor.
   /*!
     The function allows a metric descriptor to be overriden.
-    The what argument specifies what submetric is to updated.
+    The what argument specifies what submetric is to updated:
+    pmf, cdf, mean, median or qP, where P is the percentile level in
+    (0, 100), e.g. q90 or q99.9.
     */
   void insert(std::string          s,
               unsigned int         id,
               std::string          what,
               const MetricDescAvg& dsc);
+  //! Insert the descriptor of a percentile of a distribution metric.
+  void insertPercentile(std::string          s,
+                        unsigned int         id,
+                        double               level,
+                        const MetricDescAvg& dsc);
 
   //! Get the next word from configuration file.
   /*!
@@ -149,7 +181,12 @@ class Configuration : public Object
   Configuration()
       : Object("Configuration")
       , minReplics(0)
-      , maxReplics(0) {
+      , maxReplics(0)
+      , checksum(false)
+      , syncPolicy(SYNC_STOP)
+      , syncEvery(1)
+      , lag(0)
+      , snapshotEvery(0) {
   }
   //! Do nothing.
   ~Configuration() {
@@ -157,6 +194,12 @@ class Configuration : public Object
 
   //! Parse the configuration file, and close it immediately after.
   void parse(std::string inputFileName);
+  //! Return a checksum of the relevant metrics and indices.
+  /*!
+    Two configurations with the same checksum load the same samples
+    from a save file.
+    */
+  unsigned int getRelevantChecksum() const;
 
   //! Get the output file name.
   std::string getOutputFileName() const {
@@ -178,29 +221,61 @@ class Configuration : public Object
   std::string getTrailerName() const {
     return trailerName;
   }
-  //! Get the descriptor of an averaged metric.
-  void getDescAvg(bool&          valid,
-                  MetricDescAvg& dsc, // output
-                  std::string    s,
-                  unsigned int   id) { // input
-    if (avg.count(s) == 0 || id >= avg[s].size())
-      valid = false;
-    else {
-      valid = true;
-      dsc   = avg[s][id];
-    }
+  //! Return true if the runs in the save file have a checksum trailer.
+  bool getChecksum() const {
+    return checksum;
   }
-  //! Get the descriptor of a distribution metric.
-  void getDescDst(bool&          valid,
-                  MetricDescDst& dsc, // output
-                  std::string    s,
-                  unsigned int   id) { // input
-    if (dst.count(s) == 0 || id >= dst[s].size())
-      valid = false;
-    else {
-      valid = true;
-      dsc   = dst[s][id];
-    }
+  //! Get the synchronization policy of the save file.
+  SyncPolicy getSyncPolicy() const {
+    return syncPolicy;
+  }
+  //! Get the number of runs between two synchronizations of the save file.
+  unsigned int getSyncEvery() const {
+    return syncEvery;
+  }
+  //! Get the number of runs which may be accepted after the stop decision.
+  unsigned int getLag() const {
+    return lag;
+  }
+  //! Get the number of runs between two snapshots, 0 if disabled.
+  unsigned int getSnapshotEvery() const {
+    return snapshotEvery;
+  }
+  //! Get the snapshot file name, i.e., the output file name plus ".snap".
+  std::string getSnapshotName() const {
+    return outputFileName + ".snap";
+  }
+  //! Get the name of the file whose existence stops the simulation.
+  std::string getStopFileName() const {
+    return stopFileName;
+  }
+  //! Get the indices of the averaged metrics whose samples are not kept.
+  const std::map<std::string, std::set<unsigned int>>& getStreamed() const {
+    return streamed;
+  }
+  //! Get the descriptor of an averaged metric, NULL if not configured.
+  const MetricDescAvg* getDescAvg(const std::string& s,
+                                  unsigned int       id) const {
+    std::map<std::string, std::vector<MetricDescAvg>>::const_iterator it =
+        avg.find(s);
+    return it == avg.end() || id >= it->second.size() ? NULL
+                                                      : &it->second[id];
+  }
+  //! Get the descriptor of a distribution metric, NULL if not configured.
+  /*!
+    The descriptor is not copied, since it holds the map of percentiles.
+    */
+  const MetricDescDst* getDescDst(const std::string& s,
+                                  unsigned int       id) const {
+    std::map<std::string, std::vector<MetricDescDst>>::const_iterator it =
+        dst.find(s);
+    return it == dst.end() || id >= it->second.size() ? NULL
+                                                      : &it->second[id];
+  }
+
+  //! Return the percentile levels of the distribution metrics, by name.
+  const std::map<std::string, std::set<double>>& getPercentiles() const {
+    return percentiles;
   }
 
   //! Debug function to dump to an ostream the database content.
@@ -0,0 +1,133 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: convert.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           convert a save file between the run protocol format and the
+           columnar format
+*/
+
+#include <columnar.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace std;
+
+void printUsage() {
+  printf("usage: convert [-c|-r] [-z] infile outfile\n");
+  printf("convert a save file to the columnar format, or back\n");
+  printf("-c          convert to the columnar format\n");
+  printf("-r          convert to the run protocol format\n");
+  printf("-z          compress the blocks of the columnar format\n");
+  printf("by default, the direction depends on the format of infile\n");
+  exit(0);
+}
+
+int main(int argc, char* argv[]) {
+  int  ch;               // for parsing arguments
+  bool toRuns   = false; // convert to the run protocol format
+  bool toColumn = false; // convert to the columnar format
+  bool compress = false; // compress the columnar blocks
+
+  // parse command-line arguments
+  while ((ch = getopt(argc, argv, "hcrz")) != -1) {
+    switch (ch) {
+      case 'c':
+        toColumn = true;
+        break;
+      case 'r':
+        toRuns = true;
+        break;
+      case 'z':
+        compress = true;
+        break;
+      case 'h':
+      default:
+        printUsage();
+        break;
+    }
+  }
+
+  argc -= optind;
+  argv += optind;
+
+  if (argc != 2 || (toRuns && toColumn))
+    printUsage(); // does not return
+
+  try {
+    ColumnarFile  file;
+    std::ifstream is;
+    std::ofstream os;
+
+    is.open(argv[0], std::ios::in | std::ios::binary);
+    if (!is.is_open()) {
+      perror("cannot open input file");
+      exit(1);
+    }
+
+    const bool columnar = ColumnarFile::detect(is);
+    if (!toRuns && !toColumn) {
+      toRuns   = columnar;
+      toColumn = !columnar;
+    }
+    if (columnar)
+      file.read(is);
+    else
+      file.importRuns(is);
+    is.close();
+
+    os.open(argv[1], std::ios::out | std::ios::trunc | std::ios::binary);
+    if (!os.is_open()) {
+      perror("cannot open output file");
+      exit(1);
+    }
+    if (toColumn) {
+      file.setCompressed(compress);
+      file.write(os);
+    } else {
+      file.exportRuns(os);
+    }
+    os.close();
+    if (os.fail()) {
+      perror("cannot write output file");
+      exit(1);
+    }
+
+  } catch (Object& obj) {
+    printf("Exception raised by the instance #%d of class %s. ",
+           obj.getId(),
+           obj.getName().c_str());
+    perror("Terminated\n");
+    exit(1);
+  }
+
+  return 0;
+}
@@ -0,0 +1,112 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: crc32c.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the CRC32C functions
+*/
+
+#include <crc32c.h>
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#endif
+
+//! Reflected Castagnoli polynomial.
+#define CRC32C_POLY 0x82f63b78
+
+uint32_t Crc32c::table[8][256];
+bool     Crc32c::hardware = Crc32c::init();
+
+bool Crc32c::init() {
+  for (unsigned int i = 0; i < 256; i++) {
+    uint32_t crc = i;
+    for (unsigned int j = 0; j < 8; j++)
+      crc = (crc & 1) ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+    table[0][i] = crc;
+  }
+  for (unsigned int i = 0; i < 256; i++)
+    for (unsigned int k = 1; k < 8; k++)
+      table[k][i] = (table[k - 1][i] >> 8) ^ table[0][table[k - 1][i] & 0xff];
+
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+  return __builtin_cpu_supports("sse4.2");
+#else
+  return false;
+#endif
+}
+
+uint32_t Crc32c::software(uint32_t crc, const unsigned char* p, size_t n) {
+  // process 8 bytes at a time (little endian only)
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  while (n >= 8) {
+    uint32_t lo, hi;
+    memcpy(&lo, p, 4);
+    memcpy(&hi, p + 4, 4);
+    lo ^= crc;
+    crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff] ^
+          table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24] ^
+          table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff] ^
+          table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+    p += 8;
+    n -= 8;
+  }
+#endif
+  while (n-- > 0)
+    crc = (crc >> 8) ^ table[0][(crc ^ *p++) & 0xff];
+  return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2"))) uint32_t
+Crc32c::sse42(uint32_t crc, const unsigned char* p, size_t n) {
+  uint64_t c = crc;
+  while (n >= 8) {
+    uint64_t x;
+    memcpy(&x, p, 8);
+    c = _mm_crc32_u64(c, x);
+    p += 8;
+    n -= 8;
+  }
+  crc = (uint32_t)c;
+  while (n-- > 0)
+    crc = _mm_crc32_u8(crc, *p++);
+  return crc;
+}
+#else
+uint32_t Crc32c::sse42(uint32_t crc, const unsigned char* p, size_t n) {
+  return software(crc, p, n);
+}
+#endif
+
+uint32_t Crc32c::update(uint32_t crc, const void* data, size_t n) {
+  const unsigned char* p = (const unsigned char*)data;
+  crc                    = ~crc;
+  crc                    = hardware ? sse42(crc, p, n) : software(crc, p, n);
+  return ~crc;
+}
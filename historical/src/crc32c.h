@@ -0,0 +1,75 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: crc32c.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           CRC32C (Castagnoli) checksum
+*/
+
+#ifndef __MEASURE_CRC32C_H
+#define __MEASURE_CRC32C_H
+
+#include <object.h>
+
+#include <cstddef>
+#include <stdint.h>
+
+//! Utility static class to compute CRC32C (Castagnoli) checksums.
+/*!
+  The SSE4.2 crc32 instruction is used if the CPU supports it,
+  otherwise the checksum is computed in software with lookup tables.
+  */
+class Crc32c : public Object
+{
+  //! Lookup tables for the software implementation (slicing-by-8).
+  static uint32_t table[8][256];
+  //! True if the SSE4.2 instructions are available.
+  static bool hardware;
+
+  //! Fill the lookup tables and detect the CPU features. Invoked once.
+  static bool init();
+  //! Software implementation on the inverted checksum.
+  static uint32_t software(uint32_t crc, const unsigned char* p, size_t n);
+  //! SSE4.2 implementation on the inverted checksum.
+  static uint32_t sse42(uint32_t crc, const unsigned char* p, size_t n);
+
+ public:
+  //! Default constructor. Does nothing.
+  Crc32c()
+      : Object("Crc32c") {
+  }
+  //! Destructor. Does nothing.
+  ~Crc32c() {
+  }
+
+  //! Return the checksum of n bytes, continuing from a previous checksum.
+  /*!
+    Use crc == 0 for the first block of data.
+    */
+  static uint32_t update(uint32_t crc, const void* data, size_t n);
+};
+
+#endif // __MEASURE_CRC32C_H
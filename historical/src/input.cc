@@ -29,18 +29,215 @@
            body of the Input class
 */
 
+#include <codec.h>
+#include <crc32c.h>
 #include <input.h>
+#include <shmring.h>
 #include <string.h>
 
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <climits>
+#include <iterator>
+#include <sstream>
+#include <thread>
+
+namespace {
+
+//! Compute the checksum of the last SNAPSHOT_TAIL bytes before length.
+/*!
+  Return false if the save file is shorter than length.
+  */
+bool tailChecksum(std::istream&      save,
+                  unsigned long long length,
+                  unsigned int&      crc) {
+  const unsigned long long n = length < SNAPSHOT_TAIL ? length : SNAPSHOT_TAIL;
+  char                     buf[SNAPSHOT_TAIL];
+
+  save.clear();
+  save.seekg(length - n, std::ios::beg);
+  save.read(buf, n);
+  if ((unsigned long long)save.gcount() != n)
+    return false;
+  crc = Crc32c::update(0, buf, n);
+  return true;
+}
+
+//! Return true if an index of a distribution measure is confident.
+bool confident(DstMeasure& m, unsigned int i, const MetricDescDst& dstDsc) {
+  // 0 = pmf
+  // 1 = cdf
+  // 2 = mean
+  for (unsigned k = 0; k < 3; k++) {
+
+    // demultiplex the submetric descriptor
+    const MetricDescAvg* dsc = nullptr;
+
+    if (k == 0)
+      dsc = &dstDsc.pmf;
+    else if (k == 1)
+      dsc = &dstDsc.cdf;
+    else if (k == 2)
+      dsc = &dstDsc.mean;
+
+    // if the check of this submetric is not required
+    // then restart this loop
+    if (dsc == nullptr or dsc->check == false)
+      continue;
+
+    if (k == 0 || k == 1) {
+      for (unsigned int h = 0; h < m.getSize(i); h++) {
+        if (!m.getValid(i, h))
+          continue;
+        const Moments& b = k == 0 ? m.getPMF(i, h) : m.getCDF(i, h);
+        if (!b.confident(dsc->CL, dsc->threshold))
+          return false;
+      }
+    } else if (!m.getMeanPopulation(i).confident(dsc->CL, dsc->threshold)) {
+      return false;
+    }
+  }
+
+  // then the percentiles
+  std::map<double, MetricDescAvg>::const_iterator kt;
+  for (kt = dstDsc.percentiles.begin(); kt != dstDsc.percentiles.end();
+       kt++) {
+    const MetricDescAvg& dsc = kt->second; // alias
+    if (dsc.check == false)
+      continue;
+    Population& p = m.getPercentilePopulation(i, kt->first);
+    if (!p.confident(dsc.CL, dsc.threshold))
+      return false;
+  }
+  return true;
+}
+
+//! Return true if an index of a sketch measure is confident.
+bool confident(SktMeasure& m, unsigned int i, const MetricDescDst& dstDsc) {
+  if (dstDsc.mean.check == true &&
+      !m.getMeanPopulation(i).confident(dstDsc.mean.CL,
+                                        dstDsc.mean.threshold))
+    return false;
+
+  std::map<double, MetricDescAvg>::const_iterator lt;
+  for (lt = dstDsc.percentiles.begin(); lt != dstDsc.percentiles.end();
+       lt++) {
+    const MetricDescAvg& dsc = lt->second; // alias
+    if (dsc.check == false)
+      continue;
+    Population& p = m.getPercentilePopulation(i, lt->first);
+    if (!p.confident(dsc.CL, dsc.threshold))
+      return false;
+  }
+  return true;
+}
+
+//! Return the cached descriptor of an index of an averaged metric.
+/*!
+  The descriptor is looked up only the first time, and NULL is returned
+  if the index is not relevant.
+  */
+const MetricDescAvg* descAvg(const Configuration& c,
+                             DictEntry&           e,
+                             unsigned int         id) {
+  std::map<unsigned int, const MetricDescAvg*>::iterator it = e.avgDsc.find(id);
+  if (it == e.avgDsc.end()) {
+    const MetricDescAvg* dsc = c.getDescAvg(e.name, id);
+    if (dsc != NULL && dsc->isRelevant() == false)
+      dsc = NULL;
+    it = e.avgDsc.insert(std::make_pair(id, dsc)).first;
+  }
+  return it->second;
+}
+
+//! Return the cached descriptor of an index of a distribution metric.
+/*!
+  As descAvg, also used for sketch metrics.
+  */
+const MetricDescDst* descDst(const Configuration& c,
+                             DictEntry&           e,
+                             unsigned int         id) {
+  std::map<unsigned int, const MetricDescDst*>::iterator it = e.dstDsc.find(id);
+  if (it == e.dstDsc.end()) {
+    const MetricDescDst* dsc = c.getDescDst(e.name, id);
+    if (dsc != NULL && dsc->isRelevant() == false)
+      dsc = NULL;
+    it = e.dstDsc.insert(std::make_pair(id, dsc)).first;
+  }
+  return it->second;
+}
+
+//! Samples of an index of a compact run, added once the run is decoded.
+struct CompactSamples {
+  DictEntry*           e;       // metric
+  unsigned int         mid;     // index
+  const char*          samples; // samples of the bins, in the message
+  const MetricDescAvg* avgDsc;  // descriptor of an averaged metric
+  const MetricDescDst* dstDsc;  // descriptor of a distribution metric
+};
+
+//! Sketch of an index of a compact run, added once the run is decoded.
+struct CompactSketch {
+  DictEntry*           e;      // metric
+  unsigned int         mid;    // index
+  Sketch               sketch; // sketch
+  const MetricDescDst* dstDsc; // descriptor
+};
+
+} // namespace
+
+void Input::readField(std::istream& is,
+                      void*         buf,
+                      unsigned int  n,
+                      std::string*  raw) {
+  is.read((char*)buf, n);
+  if (is.eof())
+    throw *this; // check for premature end of file
+  checksum = Crc32c::update(checksum, buf, n);
+  if (raw != 0)
+    raw->append((const char*)buf, n);
+}
+
+bool Input::readMagic(std::istream& is, unsigned int magic) {
+  unsigned int x; // magic number read
+
+  // most run identifiers do not start with the same byte as the
+  // magic number, which saves a read and a seek per run
+  const int c = is.peek();
+  if (c == EOF) {
+    is.clear(); // the next read will find the end of file again
+    return false;
+  }
+  if ((unsigned char)c != (magic & 0xff))
+    return false;
+
+  is.read((char*)&x, sizeof(x));
+  if (is.gcount() != sizeof(x) || x != magic) {
+    // this is the beginning of the next run
+    is.clear();
+    is.seekg(-is.gcount(), std::ios::cur);
+    return false;
+  }
+  return true;
+}
+
+bool Input::readTrailer(std::istream& is, bool verify) {
+  unsigned int crc; // checksum of the run
+
+  if (!readMagic(is, CHECKSUM_MAGIC))
+    return false;
+  is.read((char*)&crc, sizeof(crc));
+  if (is.eof() || (verify && crc != checksum))
+    throw *this;
+  return true;
+}
+
 bool Input::readSingleRun(std::istream& is,
-                          std::ostream* os,
+                          std::string*  os,
                           bool          recover,
                           bool          onlyAvg,
                           const char*   oneMetr) {
-  //
-  // TODO: write a function to have a single line for read+check+write
-  //
-
   // both averaged and distribution metrics
   unsigned int id;     // run identifier
   unsigned int len;    // length of the strings (including trailing '\0')
@@ -50,15 +247,24 @@ bool Input::readSingleRun(std::istream& is,
   bool         valid;  // check validity of a descriptor
 
   // averaged metrics only
-  unsigned int  avg;    // number of averaged metrics
-  MetricDescAvg avgDsc; // metric descriptor
+  unsigned int         avg;           // number of averaged metrics
+  const MetricDescAvg* avgDsc = NULL; // metric descriptor
 
   // distribution metrics only
-  unsigned int  dst;       // number of distribution metrics
-  unsigned int  bin;       // number of bins of distribution metrics
-  sample_t      binSize;   // bin size of distribution metrics
-  sample_t      distLower; // lower bound of distribution metrics
-  MetricDescDst dstDsc;    // metric descriptor
+  unsigned int         dst;           // number of distribution metrics
+  unsigned int         bin;           // number of bins of the metric
+  sample_t             binSize;       // bin size of the metric
+  sample_t             distLower;     // lower bound of the metric
+  const MetricDescDst* dstDsc = NULL; // metric descriptor
+
+  // sketch metrics only
+  unsigned int        skt;      // number of sketch metrics
+  sample_t            accuracy; // relative accuracy of sketch metrics
+  sample_t            sum;      // sum of the values of a sketch
+  sample_t            zero;     // count of the values not greater than 0
+  unsigned int        buckets;  // number of non-empty buckets of a sketch
+  std::vector<int>    keys;     // keys of the buckets of a sketch
+  std::vector<double> counts;   // counts of the buckets of a sketch
 
   char metricName[MAX_METRIC_NAME];
 
@@ -73,80 +279,38 @@ bool Input::readSingleRun(std::istream& is,
 
   // if a run with the same ID has been alread read => skip this run
   if (runIdentifiers.count(id) == 1) {
-    // skip averaged metrics
-    is.read((char*)&avg, sizeof(avg));
-    for (unsigned int i = 0; i < avg; i++) {
-      is.read((char*)&ndx, sizeof(ndx));
-      is.read((char*)&len, sizeof(len));
-      if (len > MAX_METRIC_NAME)
-        throw *this;
-      // move the get pointer to the end of the current averaged metric
-      is.seekg(len + ndx * (sizeof(unsigned int) + sizeof(sample_t)),
-               std::ios::cur);
-    }
-
-    // skip distribution metrics
-    is.read((char*)&dst, sizeof(dst));
-    for (unsigned int i = 0; i < dst; i++) {
-      is.read((char*)&ndx, sizeof(ndx));
-      is.read((char*)&len, sizeof(len));
-      if (len > MAX_METRIC_NAME)
-        throw *this;
-      is.seekg(len + sizeof(binSize) + sizeof(distLower), std::ios::cur);
-      is.read((char*)&bin, sizeof(bin));
-      // move the get pointer to the end of the current distribution metric
-      is.seekg(ndx * (sizeof(unsigned int) + bin * sizeof(sample_t)),
-               std::ios::cur);
-    }
+    skipRun(is);
+    readTrailer(is, false);
     return true;
   }
 
   // insert this run ID into the set of run identifiers
   runIdentifiers.insert(id);
 
-  // write to the save file
+  // descriptors are not looked up in recover mode
+  if (recover == true)
+    uncheckedAll = true;
+
+  // copy to the save file
+  checksum = Crc32c::update(0, &id, sizeof(id));
   if (os != 0)
-    os->write((char*)&id, sizeof(id));
+    os->append((const char*)&id, sizeof(id));
 
   //
   // averaged metrics
   //
 
-  is.read((char*)&avg, sizeof(avg)); // number of averaged metrics
-  if (is.eof())
-    throw *this; // check for premature end of file
-  if (os != 0)
-    os->write((char*)&avg, sizeof(avg));
+  readField(is, &avg, sizeof(avg), os); // number of averaged metrics
 
   for (unsigned int i = 0; i < avg; i++) { // for each averaged metric
-    is.read((char*)&ndx, sizeof(ndx));     // number of indices
-    if (is.eof())
-      throw *this; // check for premature end of file
-    if (os != 0)
-      os->write((char*)&ndx, sizeof(ndx));
-    is.read((char*)&len, sizeof(len)); // length of the metric's name
-    if (is.eof())
-      throw *this; // check for premature end of file
-    if (os != 0)
-      os->write((char*)&len, sizeof(len));
+    readField(is, &ndx, sizeof(ndx), os);  // number of indices
+    readField(is, &len, sizeof(len), os);  // length of the metric's name
     if (len > MAX_METRIC_NAME)
       throw *this;
-    is.read(metricName, len); // metric's name
-    if (is.eof())
-      throw *this; // check for premature end of file
-    if (os != 0)
-      os->write(metricName, len);
-    for (unsigned int j = 0; j < ndx; j++) { // for each index
-      is.read((char*)&mid, sizeof(mid));     // metric ID
-      if (is.eof())
-        throw *this; // check for premature end of file
-      if (os != 0)
-        os->write((char*)&mid, sizeof(mid));
-      is.read((char*)&sample, sizeof(sample)); // sample
-      if (is.eof())
-        throw *this; // check for premature end of file
-      if (os != 0)
-        os->write((char*)&sample, sizeof(sample));
+    readField(is, metricName, len, os);           // metric's name
+    for (unsigned int j = 0; j < ndx; j++) {      // for each index
+      readField(is, &mid, sizeof(mid), os);       // metric ID
+      readField(is, &sample, sizeof(sample), os); // sample
 
       bool rel = true;
       // check if i need to load only one metric
@@ -156,11 +320,16 @@ bool Input::readSingleRun(std::istream& is,
       // add sample if needed ('out' or 'check' in the configuration file)
       if (recover == false)
         // TODO: this may cause SEGMENTATION FAULT, which is not good
-        configuration.getDescAvg(valid, avgDsc, metricName, mid);
-
-      if ((recover == true || (valid && avgDsc.isRelevant() == true)) &&
-          rel == true)
-        metrics.addSample(metricName, sample, mid);
+        avgDsc = configuration.getDescAvg(metricName, mid);
+
+      if ((recover == true ||
+           (avgDsc != NULL && avgDsc->isRelevant() == true)) &&
+          rel == true) {
+        AvgMeasure& m = metrics.getAvgMeasure(metricName);
+        m.addSample(sample, mid);
+        if (recover == false && avgDsc->check == true)
+          unchecked.insert(Unchecked(&m, mid, avgDsc));
+      }
     } // end - for each index
   }   // end - for each averaged metric
 
@@ -168,145 +337,793 @@ bool Input::readSingleRun(std::istream& is,
   // distribution metrics
   //
 
-  is.read((char*)&dst, sizeof(dst)); // number of distribution metrics
-  if (is.eof())
-    throw *this; // check for premature end of file
-  if (os != 0)
-    os->write((char*)&dst, sizeof(dst));
+  readField(is, &dst, sizeof(dst), os); // number of distribution metrics
 
   for (unsigned int i = 0; i < dst; i++) { // for each distribution metric
-    is.read((char*)&ndx, sizeof(ndx));     // number of indices
-    if (is.eof())
-      throw *this; // check for premature end of file
-    if (os != 0)
-      os->write((char*)&ndx, sizeof(ndx));
-    is.read((char*)&len, sizeof(len)); // length of the metric's name
-    if (is.eof())
-      throw *this; // check for premature end of file
-    if (os != 0)
-      os->write((char*)&len, sizeof(len));
+    readField(is, &ndx, sizeof(ndx), os);  // number of indices
+    readField(is, &len, sizeof(len), os);  // length of the metric's name
     if (len > MAX_METRIC_NAME)
       throw *this;
-    is.read(metricName, len); // metric's name
-    if (is.eof())
-      throw *this; // check for premature end of file
-    if (os != 0)
-      os->write(metricName, len);
-    is.read((char*)&binSize, sizeof(binSize)); // get bin size
-    if (is.eof())
-      throw *this; // check for premature end of file
-    if (os != 0)
-      os->write((char*)&binSize, sizeof(binSize));
-    is.read((char*)&distLower, sizeof(distLower)); // get lower bound
-    if (is.eof())
-      throw *this; // check for premature end of file
-    if (os != 0)
-      os->write((char*)&distLower, sizeof(distLower));
-    is.read((char*)&bin, sizeof(bin)); // number of bins
-    if (is.eof())
-      throw *this; // check for premature end of file
-    if (os != 0)
-      os->write((char*)&bin, sizeof(bin));
-    for (unsigned int j = 0; j < ndx; j++) { // for each index
-      is.read((char*)&mid, sizeof(mid));     // metric ID
-      if (is.eof())
-        throw *this; // check for premature end of file
-      if (os != 0)
-        os->write((char*)&mid, sizeof(mid));
+    readField(is, metricName, len, os);               // metric's name
+    readField(is, &binSize, sizeof(binSize), os);     // get bin size
+    readField(is, &distLower, sizeof(distLower), os); // get lower bound
+    readField(is, &bin, sizeof(bin), os);             // number of bins
+    for (unsigned int j = 0; j < ndx; j++) {          // for each index
+      readField(is, &mid, sizeof(mid), os);           // metric ID
 
       // check if this metric is relevant
       // that is, 'out' or 'check' set in the configuration file
       // if so, then valid is set to true; otherwise, to false
       if (recover == false)
-        configuration.getDescDst(valid, dstDsc, metricName, mid);
-      if (recover == true || (valid && dstDsc.isRelevant() == true))
+        dstDsc = configuration.getDescDst(metricName, mid);
+      if (recover == true || (dstDsc != NULL && dstDsc->isRelevant() == true))
         valid = true;
       else
         valid = false;
 
       // get all bin samples
-      for (unsigned int k = 0; k < bin; k++) {   // for each bin
-        is.read((char*)&sample, sizeof(sample)); // get sample
-        if (os != 0)
-          os->write((char*)&sample, sizeof(sample));
+      for (unsigned int k = 0; k < bin; k++) {      // for each bin
+        readField(is, &sample, sizeof(sample), os); // get sample
         // add sample only if i need for the distributions
         if (valid && !onlyAvg)
           metrics.addSample(metricName, sample, mid, k); // set sample
-      }                                          // end - for each sample
-    }                                            // end - for each index
+      } // end - for each sample
+
+      if (valid && !onlyAvg && recover == false)
+        unchecked.insert(
+            Unchecked(&metrics.getDstMeasure(metricName), mid, dstDsc));
+    } // end - for each index
     metrics.setDistLower(metricName, distLower); // set lower bound
     metrics.setBinSize(metricName, binSize);     // set bin size
   } // end - for each distribution metric
 
-  // flush the buffer of save file
-  if (os != 0)
-    os->flush();
+  //
+  // sketch metrics, if any
+  //
+
+  if (readMagic(is, SKETCH_MAGIC)) {
+    const unsigned int magic = SKETCH_MAGIC;
+    checksum                 = Crc32c::update(checksum, &magic, sizeof(magic));
+    if (os != 0)
+      os->append((const char*)&magic, sizeof(magic));
+    readField(is, &skt, sizeof(skt), os); // number of sketch metrics
+  } else {
+    skt = 0;
+  }
+
+  for (unsigned int i = 0; i < skt; i++) { // for each sketch metric
+    readField(is, &ndx, sizeof(ndx), os);  // number of indices
+    readField(is, &len, sizeof(len), os);  // length of the metric's name
+    if (len > MAX_METRIC_NAME)
+      throw *this;
+    readField(is, metricName, len, os);             // metric's name
+    readField(is, &accuracy, sizeof(accuracy), os); // relative accuracy
+    for (unsigned int j = 0; j < ndx; j++) {        // for each index
+      readField(is, &mid, sizeof(mid), os);         // metric ID
+
+      // sketch metrics are configured as distribution metrics
+      if (recover == false)
+        dstDsc = configuration.getDescDst(metricName, mid);
+      valid = recover == true ||
+              (dstDsc != NULL && dstDsc->isRelevant() == true);
+
+      // get the buckets
+      readField(is, &sum, sizeof(sum), os);
+      readField(is, &zero, sizeof(zero), os);
+      readField(is, &buckets, sizeof(buckets), os);
+      if (buckets > SKETCH_MAX_BUCKETS)
+        throw *this;
+      keys.resize(buckets);
+      counts.resize(buckets);
+      if (buckets > 0) {
+        readField(is, &keys[0], buckets * sizeof(int), os);
+        readField(is, &counts[0], buckets * sizeof(double), os);
+      }
+
+      // add the sketch only if needed, as for the distributions
+      if (valid && !onlyAvg) {
+        Sketch sketch(accuracy);
+        sketch.merge(sum, zero, buckets, buckets > 0 ? &keys[0] : 0,
+                     buckets > 0 ? &counts[0] : 0);
+        SktMeasure& m = metrics.getSktMeasure(metricName);
+        m.addSketch(sketch, mid);
+        if (recover == false)
+          unchecked.insert(Unchecked(&m, mid, dstDsc));
+      }
+    } // end - for each index
+  }   // end - for each sketch metric
+
+  // verify the checksum trailer, if any
+  readTrailer(is, true);
+
+  // append the checksum trailer to the save file, if configured
+  if (os != 0 && configuration.getChecksum()) {
+    const unsigned int magic = CHECKSUM_MAGIC;
+    os->append((const char*)&magic, sizeof(magic));
+    os->append((const char*)&checksum, sizeof(checksum));
+  }
+
   return true;
 }
 
+void Input::readCompactRun(const char*  buf,
+                           size_t       n,
+                           Dictionary&  dict,
+                           std::string* raw) {
+  const char*               end = buf + n;
+  uint64_t                  x;       // varint just read
+  unsigned int              count;   // number of metrics
+  unsigned int              id;      // run identifier
+  std::vector<unsigned int> indices; // indices of the current metric
+  std::string               out;     // run in the format of the save file
+  const MetricDescAvg*      avgDsc;  // averaged metric descriptor
+  const MetricDescDst*      dstDsc;  // distribution metric descriptor
+
+  // the run is decoded as a whole before changing the measures, so
+  // that a malformed run is not partially added
+  std::vector<DictEntry*>     dists;    // distribution metrics
+  std::vector<CompactSamples> samples;  // samples of the relevant indices
+  std::vector<CompactSketch>  sketches; // sketches of the relevant indices
+
+  buf = Codec::getVarint(buf, end, x);
+  if (buf == 0 || x > 0xffffffff)
+    throw *this;
+  id = x;
+
+  // if a run with the same ID has been alread read => skip this run
+  if (runIdentifiers.count(id) == 1)
+    return;
+  out.append((const char*)&id, sizeof(id));
+
+  // averaged metrics first (type == 0), then distribution metrics
+  for (unsigned int type = 0; type < 2; type++) {
+    buf = Codec::getVarint(buf, end, x);
+    if (buf == 0 || x > (uint64_t)(end - buf))
+      throw *this;
+    count = x;
+    out.append((const char*)&count, sizeof(count));
+
+    for (unsigned int i = 0; i < count; i++) { // for each metric
+      buf = Codec::getVarint(buf, end, x);
+      if (buf == 0 || x >= dict.size() ||
+          dict[x].type != (type == 0 ? METRIC_AVG : METRIC_DIST))
+        throw *this;
+      DictEntry& e = dict[x]; // alias
+
+      // indices, each of them taking at least one byte
+      buf = Codec::getVarint(buf, end, x);
+      if (buf == 0 || x > (uint64_t)(end - buf))
+        throw *this;
+      indices.resize(x);
+      if (x > 0)
+        buf = Codec::decodeDeltas(buf, end, &indices[0], x);
+      if (buf == 0)
+        throw *this;
+
+      // samples
+      const unsigned int bins = (type == 0) ? 1 : e.bins;
+      if (bins > 0 &&
+          indices.size() > (size_t)(end - buf) / (bins * sizeof(sample_t)))
+        throw *this;
+
+      // copy the header of the metric in the format of the save file
+      const unsigned int ndx = indices.size();
+      const unsigned int len = e.name.size() + 1;
+      out.append((const char*)&ndx, sizeof(ndx));
+      out.append((const char*)&len, sizeof(len));
+      out.append(e.name.c_str(), len);
+      if (type == 1) {
+        out.append((const char*)&e.binSize, sizeof(e.binSize));
+        out.append((const char*)&e.distLower, sizeof(e.distLower));
+        out.append((const char*)&e.bins, sizeof(e.bins));
+        dists.push_back(&e);
+      }
+
+      for (unsigned int j = 0; j < ndx; j++) { // for each index
+        const unsigned int mid = indices[j];
+        out.append((const char*)&mid, sizeof(mid));
+        out.append(buf, bins * sizeof(sample_t));
+
+        // descriptor of the index, NULL if not relevant
+        avgDsc = (type == 0) ? descAvg(configuration, e, mid) : NULL;
+        dstDsc = (type == 1) ? descDst(configuration, e, mid) : NULL;
+        if (avgDsc != NULL || dstDsc != NULL) {
+          const CompactSamples c = {&e, mid, buf, avgDsc, dstDsc};
+          samples.push_back(c);
+        }
+        buf += bins * sizeof(sample_t);
+      } // end - for each index
+    }     // end - for each metric
+  }
+
+  // sketch metrics, if any, whose count is omitted if there are none
+  if (buf != end) {
+    buf = Codec::getVarint(buf, end, x);
+    if (buf == 0 || x > (uint64_t)(end - buf))
+      throw *this;
+    const unsigned int magic = SKETCH_MAGIC;
+    count                    = x;
+    out.append((const char*)&magic, sizeof(magic));
+    out.append((const char*)&count, sizeof(count));
+  } else {
+    count = 0;
+  }
+
+  std::vector<int>    keys;   // keys of the buckets of a sketch
+  std::vector<double> counts; // counts of the buckets of a sketch
+  for (unsigned int i = 0; i < count; i++) { // for each metric
+    buf = Codec::getVarint(buf, end, x);
+    if (buf == 0 || x >= dict.size() || dict[x].type != METRIC_SKETCH)
+      throw *this;
+    DictEntry& e = dict[x]; // alias
+
+    // indices, as above
+    buf = Codec::getVarint(buf, end, x);
+    if (buf == 0 || x > (uint64_t)(end - buf))
+      throw *this;
+    indices.resize(x);
+    if (x > 0)
+      buf = Codec::decodeDeltas(buf, end, &indices[0], x);
+    if (buf == 0)
+      throw *this;
+
+    // copy the header of the metric in the format of the save file
+    const unsigned int ndx = indices.size();
+    const unsigned int len = e.name.size() + 1;
+    out.append((const char*)&ndx, sizeof(ndx));
+    out.append((const char*)&len, sizeof(len));
+    out.append(e.name.c_str(), len);
+    out.append((const char*)&e.accuracy, sizeof(e.accuracy));
+
+    for (unsigned int j = 0; j < ndx; j++) { // for each index
+      const unsigned int mid = indices[j];
+      out.append((const char*)&mid, sizeof(mid));
+
+      // sum and count of the values not greater than 0
+      sample_t sum;
+      sample_t zero;
+      if ((size_t)(end - buf) < 2 * sizeof(sample_t))
+        throw *this;
+      memcpy(&sum, buf, sizeof(sum));
+      memcpy(&zero, buf + sizeof(sum), sizeof(zero));
+      out.append(buf, 2 * sizeof(sample_t));
+      buf += 2 * sizeof(sample_t);
+
+      // keys, as zigzag deltas, then counts of the buckets
+      buf = Codec::getVarint(buf, end, x);
+      if (buf == 0 || x > SKETCH_MAX_BUCKETS ||
+          x > (uint64_t)(end - buf) / sizeof(double))
+        throw *this;
+      const unsigned int buckets = x;
+      keys.resize(buckets);
+      counts.resize(buckets);
+      int64_t key = 0; // key of the previous bucket
+      for (unsigned int k = 0; k < buckets; k++) {
+        buf = Codec::getVarint(buf, end, x);
+        if (buf == 0)
+          throw *this;
+        key += (int64_t)(x >> 1) ^ -(int64_t)(x & 1);
+        if (key < INT_MIN || key > INT_MAX)
+          throw *this;
+        keys[k] = key;
+      }
+      if ((size_t)(end - buf) < buckets * sizeof(double))
+        throw *this;
+      if (buckets > 0)
+        memcpy(&counts[0], buf, buckets * sizeof(double));
+      buf += buckets * sizeof(double);
+      out.append((const char*)&buckets, sizeof(buckets));
+      if (buckets > 0) {
+        out.append((const char*)&keys[0], buckets * sizeof(int));
+        out.append((const char*)&counts[0], buckets * sizeof(double));
+      }
+
+      // descriptor of the index, NULL if not relevant
+      dstDsc = descDst(configuration, e, mid);
+      if (dstDsc != NULL) {
+        const CompactSketch c = {&e, mid, Sketch(e.accuracy), dstDsc};
+        sketches.push_back(c);
+        sketches.back().sketch.merge(sum, zero, buckets,
+                                     buckets > 0 ? &keys[0] : 0,
+                                     buckets > 0 ? &counts[0] : 0);
+      }
+    } // end - for each index
+  }   // end - for each metric
+
+  if (buf != end)
+    throw *this;
+
+  // the run is valid, hence it is added to the measures
+  runIdentifiers.insert(id);
+
+  for (unsigned int i = 0; i < dists.size(); i++) {
+    DictEntry& e = *dists[i]; // alias
+    if (e.dst == NULL)
+      e.dst = &metrics.getDstMeasure(e.name);
+    e.dst->setDistLower(e.distLower);
+    e.dst->setBinSize(e.binSize);
+  }
+
+  for (unsigned int i = 0; i < samples.size(); i++) {
+    const CompactSamples& c = samples[i]; // alias
+    DictEntry&            e = *c.e;       // alias
+    if (c.avgDsc != NULL) {
+      sample_t sample;
+      memcpy(&sample, c.samples, sizeof(sample));
+      if (e.avg == NULL)
+        e.avg = &metrics.getAvgMeasure(e.name);
+      e.avg->addSample(sample, c.mid);
+      if (c.avgDsc->check == true)
+        unchecked.insert(Unchecked(e.avg, c.mid, c.avgDsc));
+    } else {
+      for (unsigned int k = 0; k < e.bins; k++) { // for each bin
+        sample_t sample;
+        memcpy(&sample, c.samples + k * sizeof(sample), sizeof(sample));
+        e.dst->addSample(sample, c.mid, k);
+      }
+      unchecked.insert(Unchecked(e.dst, c.mid, c.dstDsc));
+    }
+  }
+
+  for (unsigned int i = 0; i < sketches.size(); i++) {
+    const CompactSketch& c = sketches[i]; // alias
+    DictEntry&           e = *c.e;        // alias
+    if (e.skt == NULL)
+      e.skt = &metrics.getSktMeasure(e.name);
+    e.skt->addSketch(c.sketch, c.mid);
+    unchecked.insert(Unchecked(e.skt, c.mid, c.dstDsc));
+  }
+
+  // copy to the save file, with the checksum trailer if configured
+  if (raw != 0) {
+    raw->append(out);
+    if (configuration.getChecksum()) {
+      const unsigned int magic = CHECKSUM_MAGIC;
+      checksum                 = Crc32c::update(0, out.data(), out.size());
+      raw->append((const char*)&magic, sizeof(magic));
+      raw->append((const char*)&checksum, sizeof(checksum));
+    }
+  }
+}
+
+void Input::readColumnarFile(std::istream& is,
+                             bool          recover,
+                             bool          onlyAvg,
+                             const char*   oneMetr) {
+  ColumnarFile file;
+  file.readDirectory(is);
+
+  // the indices of the blocks are not tracked
+  uncheckedAll = true;
+
+  // runs with an identifier already read are skipped, as in readSingleRun
+  const std::vector<unsigned int>& ids = file.getRunIdentifiers(); // alias
+  std::vector<bool>                skip(ids.size());
+  for (unsigned int i = 0; i < ids.size(); i++) {
+    skip[i] = runIdentifiers.count(ids[i]) == 1;
+    runIdentifiers.insert(ids[i]);
+  }
+
+  bool                 valid;  // check validity of a descriptor
+  const MetricDescAvg* avgDsc; // averaged metric descriptor
+  const MetricDescDst* dstDsc; // distribution metric descriptor
+  Column               c;      // samples of the current block
+
+  const std::vector<ColumnDesc>& dir = file.getDirectory(); // alias
+  for (unsigned int i = 0; i < dir.size(); i++) {
+    const ColumnDesc& d = dir[i]; // alias
+
+    // skip the blocks of the metrics not requested
+    if (oneMetr != NULL && d.name != oneMetr)
+      continue;
+
+    if (d.type == METRIC_AVG) {
+      if (recover == false) {
+        avgDsc = configuration.getDescAvg(d.name, d.index);
+        if (avgDsc == NULL || avgDsc->isRelevant() == false)
+          continue;
+      }
+      file.readColumn(is, i, c);
+      for (unsigned int j = 0; j < d.size; j++)
+        if (!skip[c.runs[j]])
+          metrics.addSample(d.name, c.get(j, 0), d.index);
+
+    } else {
+      if (recover == false) {
+        dstDsc = configuration.getDescDst(d.name, d.index);
+        valid = dstDsc != NULL && dstDsc->isRelevant();
+      } else {
+        valid = true;
+      }
+      if (valid && !onlyAvg) {
+        file.readColumn(is, i, c);
+        // the bins of each run must be added in order
+        for (unsigned int j = 0; j < d.size; j++) {
+          if (skip[c.runs[j]])
+            continue;
+          for (unsigned int k = 0; k < d.bins; k++)
+            metrics.addSample(d.name, c.get(j, k), d.index, k);
+        }
+      }
+      metrics.setDistLower(d.name, d.distLower);
+      metrics.setBinSize(d.name, d.binSize);
+    }
+  }
+}
+
+bool Input::readSaveFile(std::istream& is,
+                         bool          recover,
+                         bool          onlyAvg,
+                         const char*   oneMetr) {
+  if (ColumnarFile::detect(is)) {
+    readColumnarFile(is, recover, onlyAvg, oneMetr);
+    return true;
+  }
+  while (!is.eof())
+    readSingleRun(is, 0, recover, onlyAvg, oneMetr);
+  return false;
+}
+
+void Input::skipBytes(std::istream&  is,
+                      std::streamoff n,
+                      std::streamoff end,
+                      bool           verify) {
+  if (end >= 0 && (std::streamoff)is.tellg() + n > end)
+    throw *this;
+  if (verify == false) {
+    is.seekg(n, std::ios::cur);
+    return;
+  }
+
+  // the bytes must be read to compute their checksum
+  char buf[COPY_BUFFER_SIZE];
+  while (n > 0) {
+    const unsigned int k = n < COPY_BUFFER_SIZE ? n : COPY_BUFFER_SIZE;
+    readField(is, buf, k, 0);
+    n -= k;
+  }
+}
+
+void Input::skipRun(std::istream& is, std::streamoff end, bool verify) {
+  unsigned int avg; // number of averaged metrics
+  unsigned int dst; // number of distribution metrics
+  unsigned int ndx; // number of indices
+  unsigned int len; // length of the strings (including trailing '\0')
+  unsigned int bin; // number of bins, or of buckets of a sketch
+
+  // skip averaged metrics
+  readField(is, &avg, sizeof(avg), 0);
+  for (unsigned int i = 0; i < avg; i++) {
+    readField(is, &ndx, sizeof(ndx), 0);
+    readField(is, &len, sizeof(len), 0);
+    if (len > MAX_METRIC_NAME)
+      throw *this;
+    // move the get pointer to the end of the current averaged metric
+    skipBytes(
+        is,
+        len + (std::streamoff)ndx * (sizeof(unsigned int) + sizeof(sample_t)),
+        end,
+        verify);
+  }
+
+  // skip distribution metrics
+  readField(is, &dst, sizeof(dst), 0);
+  for (unsigned int i = 0; i < dst; i++) {
+    readField(is, &ndx, sizeof(ndx), 0);
+    readField(is, &len, sizeof(len), 0);
+    if (len > MAX_METRIC_NAME)
+      throw *this;
+    skipBytes(is, len + 2 * sizeof(sample_t), end, verify);
+    readField(is, &bin, sizeof(bin), 0);
+    // move the get pointer to the end of the current distribution metric
+    skipBytes(
+        is,
+        (std::streamoff)ndx * (sizeof(unsigned int) + bin * sizeof(sample_t)),
+        end,
+        verify);
+  }
+
+  // skip sketch metrics, if any
+  unsigned int skt = 0; // number of sketch metrics
+  if (readMagic(is, SKETCH_MAGIC)) {
+    const unsigned int magic = SKETCH_MAGIC;
+    checksum                 = Crc32c::update(checksum, &magic, sizeof(magic));
+    readField(is, &skt, sizeof(skt), 0);
+  }
+  for (unsigned int i = 0; i < skt; i++) {
+    readField(is, &ndx, sizeof(ndx), 0);
+    readField(is, &len, sizeof(len), 0);
+    if (len > MAX_METRIC_NAME)
+      throw *this;
+    skipBytes(is, len + sizeof(sample_t), end, verify);
+    // the number of buckets of each sketch must be read
+    for (unsigned int j = 0; j < ndx; j++) {
+      skipBytes(is, sizeof(unsigned int) + 2 * sizeof(sample_t), end, verify);
+      readField(is, &bin, sizeof(bin), 0);
+      if (bin > SKETCH_MAX_BUCKETS)
+        throw *this;
+      skipBytes(is,
+                (std::streamoff)bin * (sizeof(int) + sizeof(double)),
+                end,
+                verify);
+    }
+  }
+}
+
+std::streamoff Input::findLastRun(std::istream& is, std::streamoff end) {
+  std::streamoff good = is.tellg(); // offset of the end of the last run
+  try {
+    for (;;) {
+      unsigned int id;
+      is.read((char*)&id, sizeof(id));
+      if (is.eof())
+        break;
+      checksum = Crc32c::update(0, &id, sizeof(id));
+      skipRun(is, end, true);
+      readTrailer(is, true);
+      good = is.tellg();
+    }
+  } catch (const Object&) {
+    // the run starting at offset good is damaged, incomplete,
+    // or its checksum does not match
+  }
+  is.clear();
+  return good;
+}
+
 bool Input::recoverData(std::string saveFile,
                         bool        onlyAvg,
-                        const char* oneMetr) {
+                        const char* oneMetr,
+                        bool        backup) {
   std::ifstream save;
-  save.open(saveFile.c_str(), std::ios::in);
+  save.open(saveFile.c_str(), std::ios::in | std::ios::binary);
   if (!save.is_open())
     throw *this;
 
-  try {
-    while (!save.eof())
-      readSingleRun(save, 0, true, onlyAvg, oneMetr);
-  } catch (const Object& obj) {
-    // if an exception is raised, then the save data file is damaged
-    // we recover it now by saving the old save data file into an
-    // '.old' file, and substituting the old file with a recovered one
-    // we assume that the first n-1 runs are safe
+  // columnar save files are written at once, hence there is
+  // nothing to recover
+  if (ColumnarFile::detect(save)) {
+    readColumnarFile(save, true, onlyAvg, oneMetr);
+    save.close();
+    return true;
+  }
+
+  // find the end of the last complete run by only reading the
+  // headers of the metrics, without loading any sample
+  save.seekg(0, std::ios::end);
+  const std::streamoff size = save.tellg();
+  save.seekg(0, std::ios::beg);
 
-    // copy the old file
-    std::ifstream inSave;
-    std::ofstream outSave;
-    char          buf[VECTOR_CHUNK_SIZE];
+  // offset of the end of the last complete run
+  const std::streamoff good = findLastRun(save, size);
+  save.close();
 
-    std::string outFileName = saveFile + ".old";
+  if (good < size) {
+    // copy the damaged tail into a '.tail' file, if requested
+    if (backup) {
+      std::ifstream inSave;
+      std::ofstream outSave;
+      char          buf[COPY_BUFFER_SIZE];
 
-    inSave.open(saveFile.c_str(), std::ios::in);
-    outSave.open(outFileName.c_str(), std::ios::out);
+      std::string outFileName = saveFile + ".tail";
+
+      inSave.open(saveFile.c_str(), std::ios::in | std::ios::binary);
+      outSave.open(outFileName.c_str(), std::ios::out | std::ios::binary);
+      if (!outSave.is_open() || !inSave.is_open())
+        throw *this;
+      inSave.seekg(good);
+      while (!inSave.eof()) {
+        inSave.read(buf, sizeof(buf));
+        outSave.write(buf, inSave.gcount());
+      }
+      inSave.close();
+      outSave.close();
+      if (outSave.fail())
+        throw *this;
+    }
 
-    if (!outSave.is_open() || !inSave.is_open())
+    // truncate the save file in place after the last complete run
+    int fd = ::open(saveFile.c_str(), O_WRONLY);
+    if (fd < 0)
+      throw *this;
+    if (::ftruncate(fd, good) != 0 || ::fsync(fd) != 0) {
+      ::close(fd);
       throw *this;
-    while (!inSave.eof()) {
-      inSave.read(buf, sizeof(buf));
-      outSave.write(buf, inSave.gcount());
     }
-    inSave.close();
-    outSave.close();
+    ::close(fd);
+  }
+
+  // load the complete runs
+  save.open(saveFile.c_str(), std::ios::in | std::ios::binary);
+  if (!save.is_open())
+    throw *this;
+  while (!save.eof())
+    readSingleRun(save, 0, true, onlyAvg, oneMetr);
+  save.close();
+
+  return good == size;
+}
 
-    std::ifstream savedFile;
-    std::ofstream repairedSave;
+bool Input::readSnapshot(std::istream& save) {
+  // the length of the save file is needed for later snapshots anyway
+  save.seekg(0, std::ios::end);
+  saveLength = save.tellg();
+  save.seekg(0, std::ios::beg);
 
-    unsigned int goodRuns = runIdentifiers.size() - 1;
-    runIdentifiers.clear();
+  if (configuration.getSnapshotEvery() == 0 || ColumnarFile::detect(save))
+    return false;
+  std::ifstream snap;
+  snap.open(configuration.getSnapshotName().c_str(),
+            std::ios::in | std::ios::binary);
+  if (!snap.is_open())
+    return false;
+  const std::string buf((std::istreambuf_iterator<char>(snap)),
+                        std::istreambuf_iterator<char>());
+  snap.close();
+
+  // verify the checksum of the whole snapshot
+  unsigned int crc; // checksum at the end of the snapshot
+  if (buf.size() < sizeof(crc))
+    return false;
+  memcpy(&crc, buf.data() + buf.size() - sizeof(crc), sizeof(crc));
+  if (Crc32c::update(0, buf.data(), buf.size() - sizeof(crc)) != crc)
+    return false;
 
-    savedFile.open(outFileName.c_str(), std::ios::in);  // old save file
-    repairedSave.open(saveFile.c_str(), std::ios::out); // new save file
-    if (!savedFile.is_open() || !repairedSave.is_open())
+  // then check that the snapshot matches the save file and configuration
+  MemoryStreamBuf    mem(buf.data(), buf.size() - sizeof(crc));
+  std::istream       is(&mem);
+  char               magic[sizeof(SNAPSHOT_MAGIC)];
+  unsigned int       version;  // format version
+  unsigned int       relevant; // checksum of the relevant metrics
+  unsigned long long length;   // length of the save file covered
+  unsigned int       tail;     // checksum of the end of the covered part
+  unsigned int       n;        // number of runs
+  unsigned int       id;       // run identifier
+  is.read(magic, sizeof(magic));
+  is.read((char*)&version, sizeof(version));
+  is.read((char*)&relevant, sizeof(relevant));
+  is.read((char*)&length, sizeof(length));
+  is.read((char*)&tail, sizeof(tail));
+  is.read((char*)&n, sizeof(n));
+  if (is.fail() || memcmp(magic, SNAPSHOT_MAGIC, sizeof(magic)) != 0 ||
+      version != SNAPSHOT_VERSION ||
+      relevant != configuration.getRelevantChecksum() || length > saveLength ||
+      !tailChecksum(save, length, crc) || crc != tail) {
+    save.clear();
+    save.seekg(0, std::ios::beg);
+    return false;
+  }
+
+  std::set<unsigned int> ids; // run identifiers in the snapshot
+  for (unsigned int i = 0; i < n && !is.fail(); i++) {
+    is.read((char*)&id, sizeof(id));
+    ids.insert(id);
+  }
+  // the measures are replaced, even if the snapshot turns out damaged
+  unchecked.clear();
+  failing      = unchecked.end();
+  uncheckedAll = true;
+  try {
+    if (is.fail())
       throw *this;
-    for (unsigned int i = 0; i < goodRuns - 1; i++) {
-      readSingleRun(savedFile, &repairedSave, true);
-    }
-    savedFile.close();
-    repairedSave.close();
+    metrics.read(is);
+  } catch (const Object&) {
+    save.clear();
+    save.seekg(0, std::ios::beg);
     return false;
   }
-  save.close();
+
+  runIdentifiers.swap(ids);
+  save.clear();
+  save.seekg(length, std::ios::beg);
   return true;
 }
 
+void Input::append(SaveWriter& saveFile, std::string& run) {
+  if (run.empty()) // empty if the run was a duplicate
+    return;
+  saveLength += run.size();
+  saveFile.append(run);
+
+  const unsigned int every = configuration.getSnapshotEvery();
+  if (every > 0 && ++unsnapped >= every) {
+    saveFile.flush();
+    writeSnapshot();
+  }
+}
+
+void Input::writeSnapshot() {
+  if (configuration.getSnapshotEvery() == 0)
+    return;
+
+  // checksum of the end of the save file, which is not modified anymore
+  std::ifstream save;
+  unsigned int  tail;
+  save.open(configuration.getOutputFileName().c_str(),
+            std::ios::in | std::ios::binary);
+  if (!save.is_open() || !tailChecksum(save, saveLength, tail))
+    throw *this;
+  save.close();
+
+  std::ostringstream       os(std::ios::out | std::ios::binary);
+  const unsigned int       version  = SNAPSHOT_VERSION;
+  const unsigned int       relevant = configuration.getRelevantChecksum();
+  const unsigned long long length   = saveLength;
+  const unsigned int       n        = runIdentifiers.size();
+  os.write(SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+  os.write((const char*)&version, sizeof(version));
+  os.write((const char*)&relevant, sizeof(relevant));
+  os.write((const char*)&length, sizeof(length));
+  os.write((const char*)&tail, sizeof(tail));
+  os.write((const char*)&n, sizeof(n));
+  std::set<unsigned int>::const_iterator it;
+  for (it = runIdentifiers.begin(); it != runIdentifiers.end(); ++it)
+    os.write((const char*)&*it, sizeof(*it));
+  metrics.write(os);
+  std::string        buf = os.str();
+  const unsigned int crc = Crc32c::update(0, buf.data(), buf.size());
+  buf.append((const char*)&crc, sizeof(crc));
+
+  // replace the previous snapshot only when the new one is complete
+  const std::string name = configuration.getSnapshotName();
+  const std::string temp = name + ".tmp";
+  std::ofstream     snap;
+  snap.open(temp.c_str(), std::ios::out | std::ios::binary);
+  if (!snap.is_open())
+    throw *this;
+  snap.write(buf.data(), buf.size());
+  snap.close();
+  if (snap.fail() || ::rename(temp.c_str(), name.c_str()) != 0)
+    throw *this;
+  unsnapped = 0;
+}
+
+std::streamoff Input::loadNewRuns(std::string    saveFile,
+                                  std::streamoff offset,
+                                  bool           onlyAvg,
+                                  const char*    oneMetr) {
+  std::ifstream save;
+  save.open(saveFile.c_str(), std::ios::in | std::ios::binary);
+  if (!save.is_open())
+    return offset; // not created yet
+  save.seekg(0, std::ios::end);
+  const std::streamoff size = save.tellg();
+
+  // columnar save files are written at once
+  save.seekg(0, std::ios::beg);
+  if (ColumnarFile::detect(save)) {
+    if (offset == 0)
+      readColumnarFile(save, true, onlyAvg, oneMetr);
+    return size;
+  }
+
+  // skip the trailer of the last run loaded, if it was incomplete then
+  save.seekg(offset, std::ios::beg);
+  try {
+    if (offset > 0)
+      readTrailer(save, false);
+  } catch (const Object&) {
+    return offset; // the trailer is still being written
+  }
+
+  // find the complete runs, then load them
+  const std::streamoff start = save.tellg();
+  const std::streamoff good  = findLastRun(save, size);
+  save.seekg(start, std::ios::beg);
+  while (save.tellg() < good)
+    readSingleRun(save, 0, true, onlyAvg, oneMetr);
+  save.close();
+
+  return good;
+}
+
 bool Input::checkSavedData() {
   std::ifstream save;
   save.open(configuration.getOutputFileName().c_str(), std::ios::in);
-  if (save.is_open())
-    while (!save.eof())
-      readSingleRun(save);
+  if (save.is_open()) {
+    readSnapshot(save);
+    readSaveFile(save);
+  }
   save.close();
 
   unsigned int n = runIdentifiers.size(); // number of runs
@@ -314,17 +1131,27 @@ bool Input::checkSavedData() {
   return (n > 1) ? checkConfidence() : false;
 }
 
+void Input::loadSaveFile() {
+  std::ifstream save;
+  bool          columnar = false;
+  save.open(configuration.getOutputFileName().c_str(), std::ios::in);
+  if (save.is_open()) {
+    readSnapshot(save);
+    columnar = readSaveFile(save);
+  }
+  save.close();
+
+  // new runs cannot be appended to a columnar save file
+  if (columnar)
+    throw *this;
+}
+
 void Input::loadData(std::string fileIn, std::string fileOut) {
   //
   // before reading from fileIn, load saved data, if any
   //
 
-  std::ifstream save;
-  save.open(configuration.getOutputFileName().c_str(), std::ios::in);
-  if (save.is_open())
-    while (!save.eof())
-      readSingleRun(save);
-  save.close();
+  loadSaveFile();
 
   // open the output file
   std::ofstream os; // output file stream
@@ -357,44 +1184,159 @@ void Input::loadData(std::string fileIn, std::string fileOut) {
   os.write((char*)&command, sizeof(command));
   os.flush();
 
-  // open the save file
-  std::ofstream saveFile;
-  saveFile.open(configuration.getOutputFileName().c_str(),
-                std::ios::out | std::ios::app);
-  if (!saveFile.is_open())
-    throw *this;
+  // open the save file, where runs are appended in the background
+  SaveWriter saveFile(configuration.getOutputFileName(),
+                      configuration.getSyncPolicy(),
+                      configuration.getSyncEvery());
+  std::string run; // bytes of the last run read
+
+  if (configuration.getLag() > 0) {
+    // the statistics are computed by another thread
+    loadPipeline(fileIn, os, saveFile);
+  } else {
+    // cycle until collected data does not fulfill the confidence requirements
+    for (;;) { // infinite loop
+
+      // open the input file
+      std::ifstream is; // input file stream
+      is.open(fileIn.c_str(), std::ios::in);
+      if (!is.is_open())
+        throw *this;
+      if (!readSingleRun(is, &run)) {
+        is.close();
+        continue;
+      }
+      is.close();
+      append(saveFile, run);
+      // check whether the simulation should stop
+      if (check() == true)
+        break;
+      // if not, then restart simulation and load new samples
+      command = 1; // go
+      os.write((char*)&command, sizeof(command));
+      os.flush();
+    }
+  }
 
-  // cycle until collected data does not fulfill the confidence requirements
-  for (;;) { // infinite loop
+  command = 0; // stop
+  os.write((char*)&command, sizeof(command));
+  os.close();
+  saveFile.close();
+  writeSnapshot();
+}
 
-    // open the input file
+void Input::loadPipeline(std::string    fileIn,
+                         std::ofstream& os,
+                         SaveWriter&    saveFile) {
+  const unsigned int lag = configuration.getLag();
+  RunQueue           queue(lag + 1);
+  bool               failed = false; // set by the statistics thread
+  bool               broken = false; // set if fileIn cannot be opened
+  std::string        run;            // bytes of the last run read
+  char               buf[COPY_BUFFER_SIZE];
+  unsigned int       command;
+
+  std::thread statistics(&Input::analyze, this, &queue, &saveFile, &failed);
+  for (;;) {
+    // read the whole run, without parsing it
     std::ifstream is; // input file stream
     is.open(fileIn.c_str(), std::ios::in);
-    if (!is.is_open())
-      throw *this;
-    if (!readSingleRun(is, &saveFile)) {
-      is.close();
-      continue;
+    if (!is.is_open()) {
+      broken = true;
+      break;
     }
+    while (is.read(buf, sizeof(buf)) || is.gcount() > 0)
+      run.append(buf, is.gcount());
     is.close();
-    // check whether the simulation should stop
-    if (check() == true)
+    if (run.empty())
+      continue;
+
+    // go, unless the statistics thread is too far behind and, after
+    // catching up, it decides that no more simulations are needed
+    if (!queue.push(run) || !queue.wait(lag))
       break;
-    // if not, then restart simulation and load new samples
     command = 1; // go
     os.write((char*)&command, sizeof(command));
     os.flush();
   }
 
-  command = 0; // stop
-  os.write((char*)&command, sizeof(command));
-  os.close();
+  // the statistics thread terminates after the runs already read
+  queue.close();
+  statistics.join();
+  if (failed || broken)
+    throw *this;
+}
+
+void Input::analyze(RunQueue* queue, SaveWriter* saveFile, bool* failed) {
+  std::string raw; // bytes of the last run popped
+  std::string run; // bytes of the last run, as in the save file
+
+  try {
+    while (queue->pop(raw)) {
+      MemoryStreamBuf buf(raw.data(), raw.size());
+      std::istream    is(&buf);
+      if (readSingleRun(is, &run))
+        append(*saveFile, run);
+      if (!queue->isStopped() && check() == true)
+        queue->stop();
+      queue->done();
+    }
+  } catch (const Object&) {
+    *failed = true;
+    queue->stop();
+  }
+}
+
+void Input::loadRing(std::string ringName) {
+  // before reading from the ring, load saved data, if any
+  loadSaveFile();
+
+  // the ring is created here, the simulator only opens it
+  ShmRing ring(ringName, true);
+
+  // if the saved data fulfills the confidence requirements, exit immediately
+  if (check() == true) {
+    ring.stop();
+    return;
+  }
+
+  // open the save file, where runs are appended in the background
+  SaveWriter saveFile(configuration.getOutputFileName(),
+                      configuration.getSyncPolicy(),
+                      configuration.getSyncEvery());
+  std::string run; // bytes of the last run read
+
+  for (;;) {
+    // read the next run in place, without copying it out of the ring
+    size_t      n;
+    const char* p = ring.read(n);
+    if (p == NULL)
+      break; // the simulator has closed the ring
+    MemoryStreamBuf buf(p, n);
+    std::istream    is(&buf);
+    readSingleRun(is, &run);
+    ring.release();
+    append(saveFile, run);
+
+    // check whether the simulation should stop
+    if (check() == true) {
+      ring.stop();
+      break;
+    }
+  }
+
   saveFile.close();
+  writeSnapshot();
 }
 
 bool Input::check() {
   unsigned int n = runIdentifiers.size(); // number of runs
 
+  // the stop file is created when the whole experiment is done
+  const std::string stopFile = configuration.getStopFileName();
+  if (!stopFile.empty() && ::access(stopFile.c_str(), F_OK) == 0)
+    return true;
+
   if (n >= configuration.getMaxReplics() ||
       (n >= configuration.getMinReplics() && n > 1 &&
        checkConfidence() == true))
@@ -403,122 +1345,69 @@ bool Input::check() {
   return false;
 }
 
-bool Input::checkConfidence() {
-  // aliases
-  std::map<std::string, AvgMeasure>& avg = metrics.getAvgMeasures();
-  std::map<std::string, DstMeasure>& dst = metrics.getDstMeasures();
-
-  // utility variables
-  bool          valid;
-  MetricDescAvg avgDsc;
-  MetricDescDst dstDsc;
+bool Input::Unchecked::confident() const {
+  if (avg != NULL)
+    return avgDsc->check == false ||
+           avg->getPopulation(id).confident(avgDsc->CL, avgDsc->threshold);
+  if (dst != NULL)
+    return ::confident(*dst, id, *dstDsc);
+  return skt->getValid(id) == false || ::confident(*skt, id, *dstDsc);
+}
 
-  //
-  // averaged measures
-  //
-  std::map<std::string, AvgMeasure>::iterator it = avg.begin();
-  for (; it != avg.end(); it++) {
-    const std::string& name = it->first;  // alias
-    AvgMeasure&        m    = it->second; // alias
-
-    m.restartPopulation();
-    int id = 0;
-    for (unsigned int j = 0; j < m.getSize(); j++) {
-      id = m.getPopulationId();
-      configuration.getDescAvg(valid, avgDsc, name, id);
-      if (m.getValid(id) && valid && avgDsc.check == true) {
-        Population& p = m.getPopulation(id);
-        if (p.mean(valid) > 0.0) {
-          sample_t x = 2.0 * p.confInterval(valid, avgDsc.CL) / p.mean(valid);
-          if (x > avgDsc.threshold)
-            return false;
-        } // TODO: what if the mean of a set of samples is 0.0 ?
+bool Input::checkConfidence() {
+  // all the indices are checked the first time, or if samples were
+  // added without tracking them
+  if (uncheckedAll == true) {
+    std::map<std::string, AvgMeasure>& avg = metrics.getAvgMeasures();
+    std::map<std::string, DstMeasure>& dst = metrics.getDstMeasures();
+    std::map<std::string, SktMeasure>& skt = metrics.getSktMeasures();
+    const MetricDescAvg* avgDsc;
+    const MetricDescDst* dstDsc;
+
+    std::map<std::string, AvgMeasure>::iterator it = avg.begin();
+    for (; it != avg.end(); it++) {
+      AvgMeasure::const_iterator jt = it->second.begin();
+      for (; jt != it->second.end(); ++jt) {
+        avgDsc = configuration.getDescAvg(it->first, jt.id());
+        if (avgDsc != NULL && avgDsc->check == true)
+          unchecked.insert(Unchecked(&it->second, jt.id(), avgDsc));
+      }
+    }
+    std::map<std::string, DstMeasure>::iterator jt = dst.begin();
+    for (; jt != dst.end(); jt++) {
+      for (unsigned int i = 0; i < jt->second.getSize(); i++) {
+        dstDsc = configuration.getDescDst(jt->first, i);
+        if (dstDsc != NULL)
+          unchecked.insert(Unchecked(&jt->second, i, dstDsc));
+      }
+    }
+    std::map<std::string, SktMeasure>::iterator kt = skt.begin();
+    for (; kt != skt.end(); kt++) {
+      for (unsigned int i = 0; i < kt->second.getSize(); i++) {
+        dstDsc = configuration.getDescDst(kt->first, i);
+        if (dstDsc != NULL)
+          unchecked.insert(Unchecked(&kt->second, i, dstDsc));
       }
-      m.nextPopulation();
     }
-    m.restartPopulation();
+    uncheckedAll = false;
   }
 
-  //
-  // distribution measures
-  //
-  std::map<std::string, DstMeasure>::iterator jt = dst.begin();
-  for (; jt != dst.end(); jt++) {
-    const std::string& name = jt->first;  // alias
-    DstMeasure&        m    = jt->second; // alias
-
-    for (unsigned int i = 0; i < m.getSize(); i++) {
-      configuration.getDescDst(valid, dstDsc, name, i);
-
-      // if the descriptor is not valid, restart the loop
-      if (!valid)
-        continue;
-
-      // otherwise, check the derived metrics and the pdf/cdf
-
-      // 0 = pmf
-      // 1 = cdf
-      // 2 = mean
-      // 3 = median
-      // 4 = percentile95
-      // 5 = percentile99
-      for (unsigned k = 0; k < 6; k++) {
-
-        // demultiplex the submetric descriptor
-        MetricDescAvg* dsc = nullptr;
-
-        if (k == 0)
-          dsc = &dstDsc.pmf;
-        else if (k == 1)
-          dsc = &dstDsc.cdf;
-        else if (k == 2)
-          dsc = &dstDsc.mean;
-        else if (k == 3)
-          dsc = &dstDsc.median;
-        else if (k == 4)
-          dsc = &dstDsc.percentile95;
-        else if (k == 5)
-          dsc = &dstDsc.percentile99;
-
-        // if the check of this submetric is not required
-        // then restart this loop
-        if (dsc != nullptr or dsc->check == false)
-          continue;
+  // the index that was not confident last time is likely to be still so
+  if (failing != unchecked.end()) {
+    if (failing->confident() == false)
+      return false;
+    unchecked.erase(failing);
+    failing = unchecked.end();
+  }
 
-        Population* p;       // population under consideration
-        double      x = 0.0; // ratio between conf interval and mean
-
-        if (k == 0 || k == 1) {
-          for (unsigned int h = 0; h < m.getSize(i); h++) {
-            if (k == 0)
-              p = &m.getPopulation(i, h);
-            else
-              p = &m.getPopulationCDF(i, h);
-
-            if (p->mean(valid) > 0.0) {
-              x = 2.0 * p->confInterval(valid, dsc->CL) / p->mean(valid);
-              if (x > dsc->threshold)
-                return false;
-            }
-          }
-        } else {
-          if (k == 2)
-            p = &m.getMeanPopulation(i);
-          else if (k == 3)
-            p = &m.getMedianPopulation(i);
-          else if (k == 4)
-            p = &m.getPercentile95Population(i);
-          else
-            p = &m.getPercentile99Population(i);
-
-          if (p->mean(valid) > 0.0) {
-            x = 2.0 * p->confInterval(valid, dsc->CL) / p->mean(valid);
-            if (x > dsc->threshold)
-              return false;
-          }
-        }
-      }
+  // then all the others, each one is removed as soon as it is confident
+  std::set<Unchecked>::iterator it = unchecked.begin();
+  while (it != unchecked.end()) {
+    if (it->confident() == false) {
+      failing = it;
+      return false;
     }
+    unchecked.erase(it++);
   }
 
   return true;
@@ -33,6 +33,7 @@
         communication protocol NS2 -> measure program
 
         unsigned int = UIN
+        int = INT
         double = DBL
         char = CHR
 
@@ -56,16 +57,110 @@ j| UIN   number of bins bj
  | DBL   second sample 1                                              |
  | DBL   ..                                                           |
  |-DBL   last sample bj-1                                            -|
+   UIN   SKETCH_MAGIC                                  -| optional section
+   UIN   no. of sketch metrics                          |
+ |-UIN   no. of indices of the metric = mj              |
+ |	UIN   length of the name of the metric = lenj      |
+ |	CHR   name of the metric, of length lenj           |
+ | DBL   relative accuracy                              |
+j| UIN   index of the i-th sketch of metric j    -|     |
+ | DBL   sum of the values                        |     |
+ | DBL   count of the values not greater than 0   | mj  |
+ | UIN   no. of non-empty buckets = n             |     |
+ | INT   keys of the buckets, increasing (n times)|     |
+ |-DBL   counts of the buckets (n times)         -|    -|
+   UIN   CHECKSUM_MAGIC                                  -| optional trailer
+   UIN   CRC32C of all the above fields of the run       -|
 
+        The section of the sketch metrics (see sketch.h) is omitted by
+        runs without any, and at most SKETCH_MAX_BUCKETS buckets are
+        allowed per sketch. Note that SKETCH_MAGIC cannot be used as a
+        run identifier, and that the section is not supported by the
+        server (see server.h) nor by columnar files (see columnar.h).
+
+        The checksum trailer is appended to each run in the save file
+        if 'checksum' is set in the configuration, and it is verified
+        whenever found. Note that CHECKSUM_MAGIC cannot be used as a
+        run identifier in save files with checksum trailers.
+*/
+
+/*
+        snapshot file format
+
+        A snapshot contains the measures loaded from the first bytes of
+        the save file, so that only the runs after them must be read
+        again. It is written to the save file name plus ".snap" if
+        'snapshot N' is set in the configuration, every N runs and on
+        stop, and it is ignored if it does not match the save file or
+        the relevant metrics in the configuration.
+
+        U64 = unsigned 64-bit integer
+        POP = population:  UIN no. of samples = n, DBL running mean,
+                           DBL running sum of squared deviations,
+                           UIN 0 if the samples are not stored,
+                           DBL samples (n times, if stored)
+
+        type  data
+        CHR   magic number "F2KRSNP" (8 bytes, including '\0')
+        UIN   format version (= 6)
+        UIN   checksum of the relevant metrics in the configuration
+        U64   length of the save file covered by the snapshot = L
+        UIN   CRC32C of the last SNAPSHOT_TAIL bytes of the save file before L
+        UIN   no. of runs = R
+        UIN   run identifiers                                       -| R times
+        UIN   no. of averaged measures
+ |-UIN   length of the name of the measure = len (without '\0')
+ | CHR   name of the measure, of length len
+j| UIN   no. of populations = p
+ | UIN   index of the population                           -| p times
+ |-POP   population                                        -|
+        UIN   no. of distribution measures
+ |-UIN   length of the name of the measure = len (without '\0')
+ | CHR   name of the measure, of length len
+ | DBL   bin size
+ | DBL   lower bound of the distribution
+ | UIN   1 if the bin size is set + 2 if the lower bound is set
+ | UIN   no. of percentile levels = q
+ | DBL   percentile levels, in increasing order (q times)
+ | UIN   no. of indices = m
+ | UIN   no. of bins of the i-th index = b                 -|
+j| UIN   no. of runs of the i-th index = r                  |
+ | UIN   first run of each bin, 0xffffffff if not valid     | m times
+ | UIN   1 if the runs are in sparse form                   |
+ | DBL   probability mass function, b values per run        |
+ |       or, in sparse form:                                |
+ | UIN   no. of non-zero values = z                         |
+ | UIN   first non-zero value of each run (r times)         |
+ | UIN   bins of the non-zero values (z times)              |
+ | DBL   non-zero values (z times)                          |
+ | UIN   no. of runs in the derived statistics              |
+ | POP   mean population                                    |
+ | POP   percentile populations, in the order of the levels-|
+ |-                                                        -|
+        UIN   no. of sketch measures
+ |-UIN   length of the name of the measure = len (without '\0')
+ | CHR   name of the measure, of length len
+ | UIN   no. of percentile levels = q
+ | DBL   percentile levels, in increasing order (q times)
+ | UIN   no. of runs added
+j| UIN   no. of indices = m
+ | POP   mean population of the i-th index               -|
+ | POP   percentile populations, in the order of the levels| m times
+ | DBL   relative accuracy of the merged sketch            |
+ |-      merged sketch, as in the run protocol above      -|
+        UIN   CRC32C of all the above fields
 */
 
 #ifndef __MEASURE_INPUT_H
 #define __MEASURE_INPUT_H
 
+#include <columnar.h>
 #include <config.h>
 #include <configuration.h>
 #include <measure.h>
 #include <object.h>
+#include <protocol.h>
+#include <runqueue.h>
 
 #include <map>
 #include <set>
@@ -85,11 +180,173 @@ class Input : public Object
   Metrics& metrics;
   //! Set of run identifiers.
   std::set<unsigned int> runIdentifiers;
+  //! Checksum of the run being read.
+  unsigned int checksum;
+  //! Length of the save file, including the runs appended so far.
+  unsigned long long saveLength;
+  //! Number of runs appended since the last snapshot.
+  unsigned int unsnapped;
+
+  //! Index of a measure whose confidence must be checked again.
+  /*!
+    Only the measure of the type of the metric is not NULL. Sketch
+    measures are described as distribution measures.
+    */
+  struct Unchecked {
+    AvgMeasure*          avg;    // averaged measure
+    DstMeasure*          dst;    // distribution measure
+    SktMeasure*          skt;    // sketch measure
+    unsigned int         id;     // index
+    const MetricDescAvg* avgDsc; // descriptor of an averaged measure
+    const MetricDescDst* dstDsc; // descriptor of the others
+
+    //! Create the index of an averaged measure.
+    Unchecked(AvgMeasure* m, unsigned int i, const MetricDescAvg* d)
+        : avg(m)
+        , dst(NULL)
+        , skt(NULL)
+        , id(i)
+        , avgDsc(d)
+        , dstDsc(NULL) {
+    }
+    //! Create the index of a distribution measure.
+    Unchecked(DstMeasure* m, unsigned int i, const MetricDescDst* d)
+        : avg(NULL)
+        , dst(m)
+        , skt(NULL)
+        , id(i)
+        , avgDsc(NULL)
+        , dstDsc(d) {
+    }
+    //! Create the index of a sketch measure.
+    Unchecked(SktMeasure* m, unsigned int i, const MetricDescDst* d)
+        : avg(NULL)
+        , dst(NULL)
+        , skt(m)
+        , id(i)
+        , avgDsc(NULL)
+        , dstDsc(d) {
+    }
+    //! Return true if the index is confident.
+    bool confident() const;
+    //! Order by measure, then by index.
+    bool operator<(const Unchecked& x) const {
+      if (avg != x.avg)
+        return avg < x.avg;
+      if (dst != x.dst)
+        return dst < x.dst;
+      if (skt != x.skt)
+        return skt < x.skt;
+      return id < x.id;
+    }
+  };
+  //! Indices with samples added since they were last found confident.
+  /*!
+    Filled as samples are read, so that checkConfidence does not have to
+    walk all the measures. All the other indices are confident, unless
+    uncheckedAll is true.
+    */
+  std::set<Unchecked> unchecked;
+  //! Index found not confident by the last check, if any.
+  std::set<Unchecked>::iterator failing;
+  //! True if samples were added without tracking the indices.
+  bool uncheckedAll;
+
+  //! Read a field of a run.
+  /*!
+    An exception is thrown on premature end of file. The checksum of the
+    current run is updated, and the field is appended to raw if raw != 0.
+    */
+  void readField(std::istream& is,
+                 void*         buf,
+                 unsigned int  n,
+                 std::string*  raw);
+  //! Read a magic number, if it is the next field.
+  /*!
+    Return true if the magic number was found. Otherwise, the stream is
+    left at the same position.
+    */
+  bool readMagic(std::istream& is, unsigned int magic);
+  //! Read the checksum trailer of a run, if any.
+  /*!
+    Return true if a trailer was found. If verify is true, an exception
+    is thrown if the checksum in the trailer does not match that of the
+    run just read.
+    */
+  bool readTrailer(std::istream& is, bool verify);
+
+  //! Read a columnar save file.
+  /*!
+    The arguments have the same meaning as in readSingleRun. Only the
+    blocks of the relevant metrics are read from the file.
+    */
+  void readColumnarFile(std::istream& fileIn,
+                        bool          recover,
+                        bool          onlyAvg,
+                        const char*   oneMetr);
+  //! Move the get pointer n bytes forward.
+  /*!
+    If end >= 0, an exception is thrown if the new position is after end.
+    If verify is true, the bytes are read to update the checksum of the
+    current run, as in readField.
+    */
+  void skipBytes(std::istream&  is,
+                 std::streamoff n,
+                 std::streamoff end,
+                 bool           verify);
+  //! Skip a run whose identifier has already been read.
+  /*!
+    Only the headers of the metrics are read, unless verify is true, in
+    which case the whole run is read to update its checksum, which must
+    already include the run identifier. If end >= 0, an exception is
+    thrown if the run does not end before the offset end.
+    */
+  void skipRun(std::istream&  is,
+               std::streamoff end    = -1,
+               bool           verify = false);
+  //! Return the offset of the end of the last complete run.
+  /*!
+    Runs are scanned from the current position up to the offset end,
+    without loading any sample. The scan stops at the first run that is
+    incomplete, or whose checksum trailer, if any, does not match.
+    */
+  std::streamoff findLastRun(std::istream& is, std::streamoff end);
+
+  //! Load the snapshot of the save file, if any.
+  /*!
+    Return true if a valid snapshot is found, in which case the metrics
+    and run identifiers are replaced by those in the snapshot, and save
+    is positioned at the first run not covered by the snapshot.
+    Otherwise, save is positioned at the beginning. In both cases, the
+    length of the save file is recorded for later snapshots.
+    */
+  bool readSnapshot(std::istream& save);
+
+  //! Read runs from fileIn and compute the statistics in another thread.
+  /*!
+    Used by loadData when a lag is configured. Each run is read as a
+    whole, pushed into a RunQueue, and the simulator is sent go without
+    waiting for the statistics, unless more than lag runs are still to
+    be checked. The simulator is sent stop as soon as the statistics
+    thread decides so. Then, the runs already read are saved anyway.
+    */
+  void loadPipeline(std::string    fileIn,
+                    std::ofstream& os,
+                    SaveWriter&    saveFile);
+  //! Body of the statistics thread of loadPipeline.
+  /*!
+    Runs are popped from queue, loaded as in readSingleRun and appended
+    to saveFile, until the queue is closed. The queue is stopped as soon
+    as no more simulations are needed, or on error, in which case failed
+    is set to true.
+    */
+  void analyze(RunQueue* queue, SaveWriter* saveFile, bool* failed);
 
  public:
   //! Read a single run from an input file.
   /*!
-    If fileOut != 0, the input is copied to fileOut. The recover flag
+    If fileOut != 0, the bytes of the run, followed by the checksum
+    trailer if configured, are appended to fileOut. The recover flag
     is set to true if you want to gather all metrics for debugging or
     recovering purposes.
     If onlyAvg == true, the distribution metrics are not loaded in memory.
@@ -97,16 +354,64 @@ class Input : public Object
     specified in this string.
     */
   bool readSingleRun(std::istream& fileIn,
-                     std::ostream* fileOut = 0,
+                     std::string*  fileOut = 0,
                      bool          recover = false,
                      bool          onlyAvg = false,
                      const char*   oneMetr = NULL);
 
+  //! Read a run of n bytes in the compact protocol (see protocol.h).
+  /*!
+    The length field of the run must not be included in buf. The
+    metrics are resolved through dict, which also caches their
+    relevance and measures. If raw != 0, the run is appended to *raw
+    in the format of readSingleRun, i.e., as in the save file. An
+    exception is thrown if the run is malformed, in which case neither
+    the run identifier nor any sample is added.
+    */
+  void readCompactRun(const char*  buf,
+                      size_t       n,
+                      Dictionary&  dict,
+                      std::string* raw = 0);
+
+  //! Read all the runs of a save file.
+  /*!
+    The save file can be either a sequence of runs, as in the
+    communication protocol, or a columnar save file (see columnar.h).
+    The arguments have the same meaning as in readSingleRun.
+    Return true if the save file is in the columnar format.
+    */
+  bool readSaveFile(std::istream& fileIn,
+                    bool          recover = false,
+                    bool          onlyAvg = false,
+                    const char*   oneMetr = NULL);
+
   //! Create an empty Input object.
   Input(Configuration& c, Metrics& m)
       : Object("Input")
       , configuration(c)
-      , metrics(m) {
+      , metrics(m)
+      , checksum(0)
+      , saveLength(0)
+      , unsnapped(0)
+      , failing(unchecked.end())
+      , uncheckedAll(true) {
+    // the percentiles of the distribution metrics are known in advance
+    const std::map<std::string, std::set<double>>& q = c.getPercentiles();
+    std::map<std::string, std::set<double>>::const_iterator it;
+    for (it = q.begin(); it != q.end(); ++it) {
+      std::set<double>::const_iterator jt;
+      for (jt = it->second.begin(); jt != it->second.end(); ++jt)
+        metrics.addPercentile(it->first, *jt);
+    }
+    // and so are the indices of the averaged metrics in streaming mode
+    const std::map<std::string, std::set<unsigned int>>& w =
+        c.getStreamed();
+    std::map<std::string, std::set<unsigned int>>::const_iterator kt;
+    for (kt = w.begin(); kt != w.end(); ++kt) {
+      std::set<unsigned int>::const_iterator lt;
+      for (lt = kt->second.begin(); lt != kt->second.end(); ++lt)
+        metrics.setStreaming(kt->first, *lt);
+    }
   }
   //! Do nothing.
   ~Input() {
@@ -127,18 +432,85 @@ Provided that:
     - the minimum number of replics has been reached
 
     This function also appends data read from fileIn to the outputfile
-    specified in the configuration file.
+    specified in the configuration file, which cannot be a columnar
+    save file. Runs are appended by a SaveWriter, according to the
+    synchronization policy in the configuration.
     */
   void loadData(std::string fileIn, std::string fileOut);
+  //! Reads data from a simulator through a shared memory ring.
+  /*!
+    The ring (see shmring.h) is created with the given name, and each
+    record is a run. The simulator stops writing runs as soon as the
+    ring is stopped, which happens under the same conditions as in
+    loadData. There is no handshake: the simulator is responsible for
+    not reusing the identifiers of saved runs, which are skipped.
+
+    Runs are decoded in place from the ring, and appended to the
+    outputfile specified in the configuration file, as in loadData.
+    */
+  void loadRing(std::string ringName);
+  //! Load the runs in the save file, if any.
+  /*!
+    If a valid snapshot is found, only the runs after it are read.
+    An exception is thrown if the save file is columnar, since new runs
+    cannot be appended to it.
+    */
+  void loadSaveFile();
+  //! Append a run to the save file, unless it is empty (i.e., a duplicate).
+  /*!
+    The content of run is moved into saveFile. If configured, a snapshot
+    is written every so many runs, after waiting for the runs to be
+    written to the save file.
+    */
+  void append(SaveWriter& saveFile, std::string& run);
+  //! Write a snapshot of the metrics, if configured.
+  /*!
+    All the runs appended must have been written to the save file.
+    The snapshot is written to a temporary file, which then replaces
+    the previous snapshot, if any.
+    */
+  void writeSnapshot();
   //! Load saved data and return true if the confidence level is reached.
   bool checkSavedData();
   //! Recover a (possibly damaged) save data file.
+  /*!
+    The save file is truncated in place after the last complete run,
+    if the last run is incomplete, or before the first run whose
+    checksum does not match, if any. The damaged tail is copied into a
+    file with the '.tail' suffix if backup is true. Then, all the
+    runs are loaded as in readSingleRun with recover == true.
+    Return false if the save file was damaged.
+    */
   bool recoverData(std::string saveFile,
                    bool        onlyAvg = false,
-                   const char* oneMetr = NULL);
+                   const char* oneMetr = NULL,
+                   bool        backup  = true);
+  //! Load the runs appended to a save file since the last call.
+  /*!
+    The runs are loaded as in recoverData, starting at offset, except
+    that the save file is never modified: an incomplete last run is
+    left in place, since it may be still being written. Return the
+    offset of the end of the last complete run, from which the next
+    call should start. A columnar save file is loaded at once.
+    */
+  std::streamoff loadNewRuns(std::string    saveFile,
+                             std::streamoff offset,
+                             bool           onlyAvg = false,
+                             const char*    oneMetr = NULL);
   //! Check whether the confidence level is reached. If so, return true.
+  /*!
+    Only the indices added to since the last check are checked, starting
+    from the one that was not confident last time, if any. All of them
+    are checked the first time, and after loading a snapshot, a columnar
+    file or runs in recover mode.
+    */
   bool checkConfidence();
   //! Check if no more simulations are needed. If so, return true.
+  /*!
+    No more simulations are needed also if the stop file in the
+    configuration exists, e.g., because the factorial effects of the
+    whole experiment have been resolved.
+    */
   bool check();
   //! Get the set of run identifiers.
   const std::set<unsigned int>& getRunIdentifiers() const {
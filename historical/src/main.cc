@@ -82,6 +82,10 @@
 #include <list>
 #include <unistd.h>
 
+#include <errno.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
 //#include <set>
 #include <iostream>
 #include <string>
@@ -118,7 +122,7 @@ double t_student(double cl, int df) {
       return t_table[df - 1][1];
   } else if (cl <= .975) {
     if (df > 30)
-      return -1; // TODO: check this value for df = infty
+      return 2.241;
     else
       return t_table[df - 1][2];
   } else {
@@ -138,6 +142,12 @@ struct savefile {
   Metrics data;
   //! Indicates the values of primary factors (low=-1, high=1)
   std::map<std::string, int> valPrFa;
+  //! Offset of the end of the last run loaded (watch mode)
+  std::streamoff offset;
+
+  savefile()
+      : offset(0) {
+  }
 };
 
 //! this structure stores the config data
@@ -151,6 +161,11 @@ class config
   int runs;
   //! utility function for parsing config file
   std::string getNextWord(std::istream& is, bool required);
+  //! Get the number of runs and the variance of each design point
+  void getVariances(bool                  id_valid,
+                    unsigned int          id,
+                    vector<unsigned int>& n,
+                    vector<double>&       s2);
 
  public:
   ~config() {
@@ -176,6 +191,33 @@ class config
   void parseConfigFile(const string confFile, string rVar, string dataDir);
   //! Load data from files
   void loadData();
+  //! Load the runs appended to a savefile since the last call
+  /*!
+    The savefile is not modified, unlike loadData. Return true if new
+    runs have been loaded.
+    */
+  bool loadNewData(int i);
+  //! Return true if all the savefiles have enough runs for the analysis
+  bool ready(bool id_valid, unsigned int id);
+  //! Redo the analysis whenever runs are appended to the savefiles
+  /*!
+    The savefile directory is watched with inotify, and only the new runs
+    are loaded. If tol >= 0, this function returns as soon as all the
+    effects are resolved (see checkEffects), after creating the stop
+    file, if any. Otherwise, it does not return. If batch > 0, the
+    next batch of runs is allocated after each analysis until then
+    (see allocate).
+    */
+  void watch(bool         molModel,
+             bool         id_valid,
+             unsigned int id,
+             double       cl,
+             string       residualFile,
+             string       quantileFile,
+             double       tol,
+             string       stopFile,
+             unsigned int batch,
+             string       planFile);
   //! Complete the design matrix with interactions
   void completeMatrix();
   //! Calculate the effects
@@ -186,6 +228,32 @@ class config
   void printOutput(double);
   //! Save data for visual test
   void saveVerifyData(string, string, bool id_valid, unsigned int id);
+  //! Return true if all the effects are resolved
+  /*!
+    An effect is resolved if its confidence interval excludes zero or
+    is smaller than tol. The confidence interval is computed from the
+    variance of each design point, which need not have the same number
+    of runs. The design points where one more run would reduce the
+    variance of the effects the most are printed.
+    */
+  bool checkEffects(double cl, double tol, bool id_valid, unsigned int id);
+  //! Create the stop file, which stops the collectors
+  void createStopFile(string stopFile);
+  //! Allocate the next batch of runs to the design points
+  /*!
+    The runs are assigned one at a time to the design point where one
+    more run reduces the variance of the effects the most, which
+    converges to the Neyman allocation, i.e., the number of runs of each
+    design point proportional to its standard deviation. Design points
+    with less than two runs are served first. The plan is printed and,
+    if planFile is not empty, saved as lines with the name of the
+    savefile and the number of runs to add, which replace the previous
+    plan atomically.
+    */
+  void allocate(unsigned int batch,
+                string       planFile,
+                bool         id_valid,
+                unsigned int id);
 };
 
 std::string config::getNextWord(std::istream& is, bool required) {
@@ -300,6 +368,108 @@ void config::loadData() {
   }
 }
 
+bool config::loadNewData(int i) {
+  Configuration conf; // empty configuration
+  const string  name = saveDir + "/" + save[i].saveFileName;
+
+  // a savefile shorter than the data loaded has been replaced
+  struct stat st;
+  if (::stat(name.c_str(), &st) == 0 && st.st_size < save[i].offset) {
+    save[i].data   = Metrics();
+    save[i].offset = 0;
+  }
+
+  Input                input(conf, save[i].data);
+  const std::streamoff offset =
+      input.loadNewRuns(name, save[i].offset, true, respVar.c_str());
+  const bool grown = offset != save[i].offset;
+  save[i].offset   = offset;
+  return grown;
+}
+
+bool config::ready(bool id_valid, unsigned int id) {
+  for (int i = 0; i < (int)exp2(numPrFac); i++) {
+    std::map<std::string, AvgMeasure>& avg = save[i].data.getAvgMeasures();
+    if (avg.count(respVar) == 0)
+      return false;
+    AvgMeasure& m = avg[respVar];
+    if (m.getSize() == 0 || (id_valid && !m.getValid(id)))
+      return false;
+    m.restartPopulation();
+    Population& p = id_valid ? m.getPopulation(id) : m.getPopulation();
+    if (p.getSize() < 2)
+      return false;
+  }
+  return true;
+}
+
+void config::watch(bool         molModel,
+                   bool         id_valid,
+                   unsigned int id,
+                   double       cl,
+                   string       residualFile,
+                   string       quantileFile,
+                   double       tol,
+                   string       stopFile,
+                   unsigned int batch,
+                   string       planFile) {
+  const int numSavefiles = (int)exp2(numPrFac);
+  const int fd           = inotify_init1(IN_CLOEXEC);
+  if (fd < 0 || inotify_add_watch(fd,
+                                  saveDir.c_str(),
+                                  IN_MODIFY | IN_CLOSE_WRITE | IN_MOVED_TO) < 0)
+    throw *this;
+
+  // load the runs already there, then analyze them whenever new ones arrive
+  for (int i = 0; i < numSavefiles; i++)
+    loadNewData(i);
+  bool first = true;
+  for (;;) {
+    if (ready(id_valid, id)) {
+      if (!first)
+        printf("\n");
+      first = false;
+      compEffects(molModel, id_valid, id);
+      compSquares(id_valid, id);
+      printOutput(cl);
+      saveVerifyData(residualFile, quantileFile, id_valid, id);
+      const bool resolved = tol >= 0 && checkEffects(cl, tol, id_valid, id);
+      if (!resolved && batch > 0)
+        allocate(batch, planFile, id_valid, id);
+      fflush(stdout);
+      if (resolved) {
+        createStopFile(stopFile);
+        ::close(fd);
+        return;
+      }
+    }
+
+    // wait until at least one savefile has new runs
+    bool grown = false;
+    while (!grown) {
+      char buf[WATCH_BUFFER_SIZE]
+          __attribute__((aligned(__alignof__(struct inotify_event))));
+      const ssize_t n = read(fd, buf, sizeof(buf));
+      if (n < 0 && errno == EINTR)
+        continue;
+      if (n <= 0)
+        throw *this;
+
+      std::set<std::string> names; // files modified
+      for (char* p = buf; p < buf + n;) {
+        const struct inotify_event* ev = (const struct inotify_event*)p;
+        if (ev->len > 0)
+          names.insert(ev->name);
+        p += sizeof(struct inotify_event) + ev->len;
+      }
+      for (int i = 0; i < numSavefiles; i++) {
+        if (names.count(save[i].saveFileName) == 1 && loadNewData(i))
+          grown = true;
+      }
+    }
+  }
+}
+
 void config::completeMatrix() {
   for (int savef = 0; savef < (int)exp2(numPrFac); savef++) {
     for (unsigned int pass = 1; pass <= numPrFac; pass++) {
@@ -392,11 +562,9 @@ void config::compSquares(bool id_valid, unsigned int id) {
       p = m.getPopulation(id);
     mean = p.mean(valid);
     many = p.getSize();
-    for (unsigned int j = 0; j < p.getSize(); j++) {
-      double run = p.getSample(valid, j);
-      ssy += pow(run, 2);
-      errTot += pow((run - mean), 2);
-    }
+    // derived from the running moments, without scanning the runs
+    ssy += p.getSquares() + many * pow(mean, 2);
+    errTot += p.getSquares();
   }
   if (valid == false)
     throw *this;
@@ -475,6 +643,8 @@ void config::saveVerifyData(string       name1,
     mean = p.mean(valid);
     for (unsigned int j = 0; j < p.getSize(); j++) {
       double run = p.getSample(valid, j);
+      if (!valid) // samples not stored
+        break;
       os << mean << " " << (run - mean) << "\n";
     }
   }
@@ -493,6 +663,8 @@ void config::saveVerifyData(string       name1,
     mean = p.mean(valid);
     for (unsigned int j = 0; j < p.getSize(); j++) {
       double run = p.getSample(valid, j);
+      if (!valid) // samples not stored
+        break;
       residuals.push_back(run - mean);
     }
   }
@@ -509,6 +681,161 @@ void config::saveVerifyData(string       name1,
   os.close();
 }
 
+bool config::checkEffects(double       cl,
+                          double       tol,
+                          bool         id_valid,
+                          unsigned int id) {
+  int                  numEffects = (int)exp2(numPrFac);
+  double               variance   = 0; // variance of the effects
+  int                  df         = 0; // degrees of freedom
+  vector<double>       gain(numEffects); // reduction with one more run
+  vector<unsigned int> n;                // number of runs
+  vector<double>       s2;               // variance of the design points
+
+  // each effect is the sum of the means of the design points, with
+  // either sign, divided by the number of design points
+  // the variance of a design point is not known with less than two runs,
+  // which is not checked by the one-shot analysis (see ready)
+  getVariances(id_valid, id, n, s2);
+  bool known = true;
+  for (int i = 0; i < numEffects; i++) {
+    if (n[i] < 2)
+      known = false;
+  }
+  if (!known) {
+    printf("effects not resolved, two runs needed at least by:");
+    for (int i = 0; i < numEffects; i++) {
+      if (n[i] < 2)
+        printf(" %s", save[i].saveFileName.c_str());
+    }
+    printf("\n");
+    return false;
+  }
+
+  for (int i = 0; i < numEffects; i++) {
+    variance += s2[i] / n[i];
+    df += (int)n[i] - 1;
+    gain[i] = s2[i] / (n[i] * (n[i] + 1.0));
+  }
+  variance /= numEffects * numEffects;
+
+  // a confidence level without a t value cannot resolve anything
+  const double t = t_student(cl, df);
+  if (t <= 0) {
+    printf("effects not resolved, no t value for %d degrees of freedom\n",
+           df);
+    return false;
+  }
+  const double confInt = t * sqrt(variance);
+
+  bool                               resolved = true;
+  std::map<string, double>::iterator it       = risp.begin();
+  for (; it != risp.end(); it++) {
+    if (it->first != respVar && fabs(it->second) <= confInt && confInt >= tol)
+      resolved = false;
+  }
+  if (resolved) {
+    printf("effects resolved [+-%f]\n", confInt);
+    return true;
+  }
+
+  // the design points with an above-average reduction need more runs
+  double average = 0;
+  for (int i = 0; i < numEffects; i++)
+    average += gain[i] / numEffects;
+  printf("effects not resolved [+-%f], more runs needed by:", confInt);
+  for (int i = 0; i < numEffects; i++) {
+    if (gain[i] >= average)
+      printf(" %s", save[i].saveFileName.c_str());
+  }
+  printf("\n");
+  return false;
+}
+
+void config::getVariances(bool                  id_valid,
+                          unsigned int          id,
+                          vector<unsigned int>& n,
+                          vector<double>&       s2) {
+  const int numEffects = (int)exp2(numPrFac);
+  n.assign(numEffects, 0);
+  s2.assign(numEffects, 0);
+  for (int i = 0; i < numEffects; i++) {
+    std::map<std::string, AvgMeasure>& avg = save[i].data.getAvgMeasures();
+    if (avg.count(respVar) == 0)
+      continue;
+    AvgMeasure& m = avg[respVar];
+    if (m.getSize() == 0 || (id_valid && !m.getValid(id)))
+      continue;
+    m.restartPopulation();
+    Population& p = id_valid ? m.getPopulation(id) : m.getPopulation();
+    n[i]          = p.getSize();
+    if (n[i] > 1)
+      s2[i] = p.getSquares() / (n[i] - 1.0);
+  }
+}
+
+void config::allocate(unsigned int batch,
+                      string       planFile,
+                      bool         id_valid,
+                      unsigned int id) {
+  const int            numEffects = (int)exp2(numPrFac);
+  vector<unsigned int> n;  // number of runs, including those allocated
+  vector<double>       s2; // variance of the design points
+  vector<unsigned int> plan(numEffects, 0);
+
+  // the variance of the effects is the sum of s2 / n over the design
+  // points, hence the reduction with one more run is s2 / (n * (n + 1))
+  getVariances(id_valid, id, n, s2);
+  for (unsigned int k = 0; k < batch; k++) {
+    int    best = 0;  // design point with the largest reduction
+    double max  = -1; // largest reduction
+    for (int i = 0; i < numEffects; i++) {
+      const double gain =
+          n[i] < 2 ? HUGE_VAL : s2[i] / (n[i] * (n[i] + 1.0));
+      if (gain > max) {
+        max  = gain;
+        best = i;
+      }
+    }
+    n[best]++;
+    plan[best]++;
+  }
+
+  printf("next batch:");
+  for (int i = 0; i < numEffects; i++) {
+    if (plan[i] > 0)
+      printf(" %s+%u", save[i].saveFileName.c_str(), plan[i]);
+  }
+  printf("\n");
+
+  if (planFile.empty())
+    return;
+
+  // runners may read the plan at any time, so it is never left half-written
+  const string  tmpName = planFile + ".tmp";
+  std::ofstream os;
+  os.open(tmpName.c_str(), std::ios::out | std::ios::trunc);
+  if (!os.is_open())
+    throw *this;
+  for (int i = 0; i < numEffects; i++) {
+    if (plan[i] > 0)
+      os << save[i].saveFileName << ' ' << plan[i] << '\n';
+  }
+  os.close();
+  if (os.fail() || ::rename(tmpName.c_str(), planFile.c_str()) != 0)
+    throw *this;
+}
+
+void config::createStopFile(string stopFile) {
+  if (stopFile.empty())
+    return;
+  std::ofstream os;
+  os.open(stopFile.c_str(), std::ios::out);
+  if (!os.is_open())
+    throw *this;
+  os.close();
+}
+
 void printUsage() {
   printf("usage: factorial2kr:\n");
   printf("factorial2kr path_config_file\n");
@@ -519,6 +846,14 @@ void printUsage() {
   printf("-d name     specify the directory of savefiles\n");
   printf("-m          use a moltiplicative model for analisys\n");
   printf("-n id	    id run to use\n");
+  printf("-w          watch the savefiles and redo the analysis on new runs\n");
+  printf("-e tol      check that all the effects are resolved, i.e., their\n");
+  printf("            confidence interval excludes 0 or is smaller than tol\n");
+  printf("            (additive model only); with -w, stop when they are\n");
+  printf("-s name     create the stop file 'name' when they are resolved\n");
+  printf("-a runs     allocate 'runs' more runs to the savefiles, unless\n");
+  printf("            the effects are resolved (additive model only)\n");
+  printf("-p name     save the allocation to the plan file 'name'\n");
   exit(0);
 }
 
@@ -534,9 +869,14 @@ int main(int argc, char* argv[]) {
   bool         molModel     = false;
   bool         verbose      = false;
   bool         id_valid     = false;
+  bool         watch        = false;
+  double       tol          = -1; // no check of the effects
+  string       stopFile     = "";
+  unsigned int batch        = 0; // no allocation of the next runs
+  string       planFile     = "";
   unsigned int id_run       = 0;
   // parse command-line arguments
-  while ((ch = getopt(argc, argv, "hc:q:r:o:mn:")) != -1) {
+  while ((ch = getopt(argc, argv, "hc:q:r:o:mn:we:s:a:p:")) != -1) {
     switch (ch) {
       case 'h':
         printUsage();
@@ -566,6 +906,21 @@ int main(int argc, char* argv[]) {
         id_run   = atoi(optarg);
         id_valid = true;
         break;
+      case 'w':
+        watch = true;
+        break;
+      case 'e':
+        tol = atof(optarg);
+        break;
+      case 's':
+        stopFile = optarg;
+        break;
+      case 'a':
+        batch = atoi(optarg);
+        break;
+      case 'p':
+        planFile = optarg;
+        break;
       default:
         printUsage();
         break;
@@ -575,7 +930,7 @@ int main(int argc, char* argv[]) {
   argc -= optind;
   argv += optind;
 
-  if (argc > 1 || argc == 0)
+  if (argc > 1 || argc == 0 || (molModel && (tol >= 0 || batch > 0)))
     printUsage(); // does not return
 
   if (argc == 1)
@@ -586,6 +941,20 @@ int main(int argc, char* argv[]) {
       printf("Parsing config file...\n");
     // parse config file
     cfg.parseConfigFile(configFileName, rVar, dataDir);
+    if (watch == true) {
+      cfg.completeMatrix();
+      cfg.watch(molModel,
+                id_valid,
+                id_run,
+                cl,
+                residualFile,
+                quantileFile,
+                tol,
+                stopFile,
+                batch,
+                planFile);
+      exit(0);
+    }
     if (verbose == true)
       printf("Loadnig data...\n");
     // load data
@@ -610,6 +979,11 @@ int main(int argc, char* argv[]) {
       printf("Saving data for visual tests...\n");
     // save data for visual test
     cfg.saveVerifyData(residualFile, quantileFile, id_valid, id_run);
+    // check whether the effects are resolved, otherwise plan more runs
+    if (tol >= 0 && cfg.checkEffects(cl, tol, id_valid, id_run))
+      cfg.createStopFile(stopFile);
+    else if (batch > 0)
+      cfg.allocate(batch, planFile, id_valid, id_run);
 
   } catch (Object& obj) {
     printf("Exception raised by the instance #%d of class %s. ",
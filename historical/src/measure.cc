@@ -29,18 +29,289 @@
            body of the main project classes
 */
 
+#include <algorithm>
+#include <climits>
 #include <fstream>
+#include <iomanip>
 #include <measure.h>
+#include <parallel.h>
 #include <sstream>
 
+namespace {
+
+//! Write a value to a binary stream.
+template <class T>
+void put(std::ostream& os, const T& x) {
+  os.write((const char*)&x, sizeof(x));
+}
+
+//! Read a value from a binary stream. Return false on premature end of file.
+template <class T>
+bool get(std::istream& is, T& x) {
+  is.read((char*)&x, sizeof(x));
+  return !is.fail();
+}
+
+//! Write a metric name, including its length, to a binary stream.
+void writeName(std::ostream& os, const std::string& name) {
+  const unsigned int len = name.size();
+  put(os, len);
+  os.write(name.data(), len);
+}
+
+//! Read a metric name. Return false on premature end of file.
+bool readName(std::istream& is, std::string& name) {
+  unsigned int len;
+  if (!get(is, len) || len >= MAX_METRIC_NAME)
+    return false;
+  name.resize(len);
+  is.read(&name[0], len);
+  return !is.fail();
+}
+
+//! Return the order in which the derived statistics are printed.
+/*!
+  The median comes first, then the mean (as 0), then the other
+  percentile levels in increasing order.
+  */
+std::vector<double> derivedOrder(const std::vector<double>& levels) {
+  std::vector<double> order;
+  order.push_back(50);
+  order.push_back(0);
+  for (unsigned int l = 0; l < levels.size(); l++) {
+    if (levels[l] != 50)
+      order.push_back(levels[l]);
+  }
+  return order;
+}
+
+//! Append the derived statistics of an index to the files of a measure.
+/*!
+  The files are named after prefix. Return false on error.
+  */
+template <class M>
+bool dumpDerived(M&                 m,
+                 unsigned int       i,
+                 const std::string& prefix,
+                 const std::string& hdr,
+                 double             cl) {
+  bool                      valid;
+  const std::vector<double> order = derivedOrder(m.getPercentiles());
+  for (unsigned int l = 0; l < order.size(); l++) {
+    Population& p = order[l] == 0 ? m.getMeanPopulation(i)
+                                  : m.getPercentilePopulation(i, order[l]);
+    if (p.getSize() == 0)
+      continue;
+
+    // open the output file
+    std::ofstream     os;
+    std::string       filename;
+    std::stringstream buf;
+    buf << prefix;
+    if (order[l] == 0)
+      buf << "_avg.dat";
+    else if (order[l] == 50)
+      buf << "_q50.dat";
+    else
+      buf << '_' << order[l] << ".dat";
+    getline(buf, filename);
+    os.open(filename.c_str(), std::ios::out | std::ios::app);
+    if (!os.is_open())
+      return false;
+
+    // print the value
+    os << hdr << "," << i << "," << p.mean(valid) << ","
+       << p.confInterval(valid, cl) << '\n';
+
+    // close the output file
+    os.close();
+  }
+  return true;
+}
+
+//! Print the derived statistics of an index.
+template <class M>
+void dumpDerived(std::ostream& os, M& m, unsigned int i, double cl) {
+  bool                      valid;
+  const std::vector<double> order = derivedOrder(m.getPercentiles());
+  for (unsigned int l = 0; l < order.size(); l++) {
+    Population& p = order[l] == 0 ? m.getMeanPopulation(i)
+                                  : m.getPercentilePopulation(i, order[l]);
+    if (p.getSize() == 0)
+      continue;
+
+    std::stringstream label;
+    if (order[l] == 0)
+      label << "mean";
+    else if (order[l] == 50)
+      label << "median";
+    else
+      label << 'q' << order[l];
+    os << "(" << i << ") " << std::setw(6) << std::left << label.str()
+       << std::right << " = ";
+    p.dump(os);
+    os << " [" << p.mean(valid) << ", " << p.confInterval(valid, cl) << "]"
+       << '\n';
+  }
+}
+
+//! Print the populations of an averaged measure, each to its own line.
+struct PrintTask : public Parallel::Task {
+  //! Populations to be printed.
+  const std::vector<AvgMeasure::const_iterator>& pops;
+  //! Header of the lines printed to file, NULL to print the samples.
+  const std::string* hdr;
+  //! Confidence level.
+  double cl;
+  //! Line of each population.
+  std::vector<std::string>& lines;
+
+  //! Create a task printing pops to lines.
+  PrintTask(const std::vector<AvgMeasure::const_iterator>& p,
+            const std::string*                             h,
+            double                                         c,
+            std::vector<std::string>&                      l)
+      : pops(p)
+      , hdr(h)
+      , cl(c)
+      , lines(l) {
+  }
+  //! Print the populations from first to last (excluded).
+  void run(unsigned int first, unsigned int last) {
+    bool valid;
+    for (unsigned int k = first; k < last; k++) {
+      const Population&  p = *pops[k]; // alias
+      std::ostringstream os;
+      if (hdr != NULL) {
+        os << *hdr << "," << pops[k].id() << "," << p.mean(valid) << ","
+           << p.confInterval(valid, cl) << '\n';
+      } else {
+        os << "(" << pops[k].id() << ") = ";
+        p.dump(os);
+        os << " [" << p.mean(valid) << ", " << p.confInterval(valid, cl)
+           << "]" << '\n';
+      }
+      lines[k] = os.str();
+    }
+  }
+};
+
+//! Print the populations of an averaged measure, formatted in parallel.
+/*!
+  The lines are printed in id order, as with a single thread. If hdr is
+  NULL, the samples are printed as well (see Metrics::dump()).
+  */
+void printAvg(std::ostream&      os,
+              const AvgMeasure&  m,
+              const std::string* hdr,
+              double             cl) {
+  std::vector<AvgMeasure::const_iterator> pops;
+  pops.reserve(m.getSize());
+  for (AvgMeasure::const_iterator it = m.begin(); it != m.end(); ++it)
+    pops.push_back(it);
+
+  std::vector<std::string> lines(pops.size());
+  PrintTask                task(pops, hdr, cl, lines);
+  Parallel().run(pops.size(), task);
+  for (unsigned int k = 0; k < lines.size(); k++)
+    os << lines[k];
+}
+
+//! Bring all the indices of a distribution measure up to date.
+struct UpdateTask : public Parallel::Task {
+  //! Measure to be updated.
+  DstMeasure& m;
+
+  //! Create a task updating m.
+  UpdateTask(DstMeasure& x)
+      : m(x) {
+  }
+  //! Update the indices from first to last (excluded).
+  void run(unsigned int first, unsigned int last) {
+    for (unsigned int i = first; i < last; i++)
+      m.update(i);
+  }
+};
+
+//! Bring all the indices of a distribution measure up to date in parallel.
+/*!
+  Each index holds many runs, hence each one is worth a thread.
+  */
+void updateAll(DstMeasure& m) {
+  UpdateTask task(m);
+  Parallel(1).run(m.getSize(), task);
+}
+
+} // namespace
+
+//
+// class Moments
+//
+
+void Moments::merge(const Moments& m) {
+  if (m.n == 0)
+    return;
+  const double delta = m.avg - avg;
+  const double total = (double)n + m.n;
+  avg += delta * m.n / total;
+  m2 += m.m2 + delta * delta * n / total * m.n;
+  n += m.n;
+}
+
+bool Moments::confident(double cl, double th) const {
+  bool         valid;
+  const double m = mean(valid);
+  // TODO: what if the mean of a set of samples is 0.0 ?
+  return !(m > 0.0 && 2.0 * confInterval(valid, cl) / m > th);
+}
+
 //
 // class Population
 //
 
 void Population::addSample(sample_t x) {
-  if (population.size() == population.capacity())
-    population.reserve(population.size() + VECTOR_CHUNK_SIZE);
-  population.push_back(x);
+  if (!streaming)
+    population.push_back(x);
+  moments.add(x);
+}
+
+void Population::merge(const Population& p) {
+  if (p.streaming)
+    setStreaming();
+  if (!streaming) {
+    const unsigned int n = p.population.size(); // p may be this
+    for (unsigned int i = 0; i < n; i++)
+      population.push_back(p.population[i]);
+  }
+  moments.merge(p.moments);
+}
+
+void Population::setStreaming() {
+  streaming = true;
+  population.resize(0);
+}
+
+bool Population::confident(double cl, double th) const {
+  // the result does not change until a new sample is added
+  if (checkedSize == moments.getSize() && moments.getSize() > 0 &&
+      checkedCL == cl && checkedThreshold == th)
+    return checkedResult;
+
+  checkedResult    = moments.confident(cl, th);
+  checkedSize      = moments.getSize();
+  checkedCL        = cl;
+  checkedThreshold = th;
+  return checkedResult;
+}
+
+void Population::swap(Population& p) {
+  population.swap(p.population);
+  std::swap(moments, p.moments);
+  std::swap(streaming, p.streaming);
+  std::swap(checkedSize, p.checkedSize);
+  std::swap(checkedCL, p.checkedCL);
+  std::swap(checkedThreshold, p.checkedThreshold);
+  std::swap(checkedResult, p.checkedResult);
 }
 
 sample_t Population::getSample(bool& valid, unsigned int i) {
@@ -52,7 +323,46 @@ sample_t Population::getSample(bool& valid, unsigned int i) {
   return population[i];
 }
 
-void Population::dump(std::ostream& os) {
+void Population::write(std::ostream& os) const {
+  const unsigned int n = moments.getSize();
+  put(os, n);
+  bool         valid;
+  const double avg = moments.mean(valid);
+  put(os, valid ? avg : 0.0);
+  put(os, moments.getSquares());
+  const unsigned int stored = streaming ? 0 : 1;
+  put(os, stored);
+  for (unsigned int k = 0; k < population.spans(); k++) {
+    unsigned int    size = 0;
+    const sample_t* x = population.span(k, size);
+    os.write((const char*)x, size * sizeof(sample_t));
+  }
+}
+
+bool Population::read(std::istream& is) {
+  unsigned int n;
+  double       avg;
+  double       m2;
+  unsigned int stored;
+  if (!get(is, n) || !get(is, avg) || !get(is, m2) || !get(is, stored))
+    return false;
+  moments   = Moments(n, avg, m2);
+  streaming = stored == 0;
+  population.resize(streaming ? 0 : n);
+  for (unsigned int k = 0; k < population.spans(); k++) {
+    unsigned int size = 0;
+    sample_t*    x = population.span(k, size);
+    is.read((char*)x, size * sizeof(sample_t));
+  }
+  checkedSize = 0;
+  return !is.fail();
+}
+
+void Population::dump(std::ostream& os) const {
+  if (streaming) {
+    os << moments.getSize() << " samples, not stored";
+    return;
+  }
   for (unsigned int i = 0; i < population.size(); i++) {
     os << population[i];
     if (i < population.size() - 1)
@@ -64,218 +374,742 @@ void Population::dump(std::ostream& os) {
 // class AvgMeasure
 //
 
-void AvgMeasure::addSample(sample_t x, unsigned int id) {
-  populations[id].addSample(x);
+Population& AvgMeasure::find(unsigned int id) {
+  if (id < dense.size()) {
+    if (!present[id]) {
+      present[id] = true;
+      count++;
+    }
+    return dense[id];
+  }
+
+  // ids not too far away are added to the dense table, which grows
+  // geometrically, taking over the populations in the sparse map
+  const unsigned int limit = count > DENSE_MIN_SIZE / 2 ? 2 * count
+                                                         : DENSE_MIN_SIZE;
+  if (id >= limit) {
+    std::map<unsigned int, Population>::iterator jt = sparse.find(id);
+    if (jt != sparse.end())
+      return jt->second;
+    count++;
+    return sparse[id];
+  }
+
+  unsigned int size = 2 * dense.size();
+  if (size <= id)
+    size = id + 1;
+  std::vector<Population> table(size);
+  for (unsigned int i = 0; i < dense.size(); i++)
+    table[i].swap(dense[i]);
+  dense.swap(table);
+  present.resize(size, false);
+  while (!sparse.empty() && sparse.begin()->first < size) {
+    dense[sparse.begin()->first].swap(sparse.begin()->second);
+    present[sparse.begin()->first] = true;
+    sparse.erase(sparse.begin());
+  }
+  if (!present[id]) {
+    present[id] = true;
+    count++;
+  }
+  return dense[id];
+}
+
+Population& AvgMeasure::create(unsigned int id) {
+  Population& p = find(id);
+  if (!streamed.empty() && !p.getStreaming() && streamed.count(id) == 1)
+    p.setStreaming();
+  return p;
+}
+
+void AvgMeasure::merge(const AvgMeasure& m) {
+  for (const_iterator it = m.begin(); it != m.end(); ++it)
+    create(it.id()).merge(*it);
+}
+
+void AvgMeasure::setStreaming(unsigned int id) {
+  streamed.insert(id);
+  if (getValid(id))
+    getPopulation(id).setStreaming();
 }
 
 Population& AvgMeasure::getPopulation(unsigned int id) {
-  if (populations.find(id) == populations.end())
+  if (!getValid(id))
     throw *this;
-  return populations[id];
+  return id < dense.size() ? dense[id] : sparse.find(id)->second;
+}
+
+const Population& AvgMeasure::getPopulation(unsigned int id) const {
+  if (!getValid(id))
+    throw *this;
+  return id < dense.size() ? dense[id] : sparse.find(id)->second;
 }
 
 Population& AvgMeasure::getPopulation() {
-  return it->second;
+  return pos < dense.size() ? dense[pos] : it->second;
 }
 
 unsigned int AvgMeasure::getPopulationId() {
-  return it->first;
+  return pos < dense.size() ? pos : it->first;
 }
 
 void AvgMeasure::nextPopulation() {
-  ++it;
+  if (pos < dense.size()) {
+    pos++;
+    skip();
+  } else {
+    ++it;
+  }
 }
 
 void AvgMeasure::restartPopulation() {
-  it = populations.begin();
+  pos = 0;
+  skip();
+  it = sparse.begin();
+}
+
+bool AvgMeasure::getValid(unsigned int id) const {
+  if (id < dense.size())
+    return present[id];
+  return sparse.find(id) != sparse.end();
 }
 
-bool AvgMeasure::getValid(unsigned int id) {
-  return populations.find(id) != populations.end();
+void AvgMeasure::write(std::ostream& os) const {
+  put(os, count);
+  for (unsigned int i = 0; i < dense.size(); i++) {
+    if (!present[i])
+      continue;
+    put(os, i);
+    dense[i].write(os);
+  }
+  std::map<unsigned int, Population>::const_iterator jt;
+  for (jt = sparse.begin(); jt != sparse.end(); ++jt) {
+    put(os, jt->first);
+    jt->second.write(os);
+  }
+}
+
+void AvgMeasure::read(std::istream& is) {
+  unsigned int n;  // number of populations
+  unsigned int id; // index of the population
+  dense.clear();
+  present.clear();
+  sparse.clear();
+  count = 0;
+  if (!get(is, n))
+    throw *this;
+  for (unsigned int i = 0; i < n; i++) {
+    if (!get(is, id) || !find(id).read(is))
+      throw *this;
+  }
+  restartPopulation();
 }
 
 //
 // class DstMeasure
 //
 
-void DstMeasure::addSample(sample_t x, unsigned int id, unsigned int bin) {
-  // static variable used to compute the cumulative distribution
-  // this value is reset to 0.0 whenever the first bin (bin == 0)
-  // is added to this DstMeasure object
-  static sample_t cumulative = 0.0;
-  if (bin == 0)
-    cumulative = 0;
-
-  // update the static variable cumulative
-  cumulative += x;
-
-  // check whether more entries must be added to the array of populations
-  if (id >= populations.size()) {
-    if (populations.size() == populations.capacity()) {
-      const unsigned int n = populations.size();
-      populations.reserve(n + VECTOR_CHUNK_SIZE);
-      populationsCDF.reserve(n + VECTOR_CHUNK_SIZE);
-      valid.reserve(n + VECTOR_CHUNK_SIZE);
+void DstMeasure::Histogram::swap(Histogram& h) {
+  std::swap(bins, h.bins);
+  std::swap(runs, h.runs);
+  pmf.swap(h.pmf);
+  std::swap(sparse, h.sparse);
+  std::swap(nonZero, h.nonZero);
+  start.swap(h.start);
+  nzBins.swap(h.nzBins);
+  nzValues.swap(h.nzValues);
+  valid.swap(h.valid);
+  first.swap(h.first);
+  std::swap(last, h.last);
+  pmfMoments.swap(h.pmfMoments);
+  cdfMoments.swap(h.cdfMoments);
+  std::swap(derivedLast, h.derivedLast);
+  mean.swap(h.mean);
+  quantiles.swap(h.quantiles);
+}
+
+void DstMeasure::Histogram::widen(unsigned int size) {
+  // the only run can be extended in place, otherwise all the runs
+  // must be moved to make room for the new bins
+  if (sparse) {
+    // nothing to move
+  } else if (runs <= 1) {
+    pmf.resize(runs * size, 0);
+  } else {
+    std::vector<sample_t> table(runs * size, 0);
+    for (unsigned int r = 0; r < runs; r++)
+      std::copy(&pmf[r * bins], &pmf[r * bins] + bins, &table[r * size]);
+    pmf.swap(table);
+  }
+  bins = size;
+  valid.resize(size, false);
+  first.resize(size, 0);
+  pmfMoments.resize(size);
+  cdfMoments.resize(size);
+}
+
+void DstMeasure::Histogram::newRun() {
+  // the sparse form is worth it if the last run was mostly zeros
+  if (!sparse && runs > 0 && bins >= SPARSE_MIN_BINS && 2 * nonZero < bins) {
+    start.resize(runs);
+    for (unsigned int r = 0; r < runs; r++) {
+      start[r] = nzBins.size();
+      for (unsigned int j = 0; j < bins; j++) {
+        if (pmf[r * bins + j] != 0) {
+          nzBins.push_back(j);
+          nzValues.push_back(pmf[r * bins + j]);
+        }
+      }
     }
-    populations.resize(id + 1);
-    populationsCDF.resize(id + 1);
-    valid.resize(id + 1);
-  }
-
-  if (bin >= populations[id].size()) {
-    unsigned int oldSize = populations[id].size();
-    if (populations[id].size() == populations[id].capacity()) {
-      const unsigned int n = populations[id].size();
-      populations[id].reserve(n + VECTOR_CHUNK_SIZE);
-      populationsCDF[id].reserve(n + VECTOR_CHUNK_SIZE);
-      valid[id].reserve(n + VECTOR_CHUNK_SIZE);
+    std::vector<sample_t>().swap(pmf);
+    sparse = true;
+  }
+
+  runs++;
+  nonZero = 0;
+  if (sparse)
+    start.push_back(nzBins.size());
+  else
+    pmf.resize(runs * bins, 0);
+}
+
+const sample_t*
+DstMeasure::Histogram::getRun(unsigned int           r,
+                              std::vector<sample_t>& row) const {
+  if (!sparse)
+    return &pmf[r * bins];
+  unsigned int begin;
+  unsigned int end;
+  pairs(r, begin, end);
+  row.assign(bins, 0);
+  for (unsigned int k = begin; k < end; k++)
+    row[nzBins[k]] = nzValues[k];
+  return &row[0];
+}
+
+void DstMeasure::Histogram::append(const Histogram& h) {
+  if (h.runs == 0)
+    return;
+  if (h.bins > bins)
+    widen(h.bins);
+
+  // the bins valid only in h become valid from its first run
+  for (unsigned int j = 0; j < h.bins; j++) {
+    if (h.valid[j] && !valid[j]) {
+      valid[j] = true;
+      first[j] = runs + h.first[j];
     }
-    populations[id].resize(bin + 1);
-    populationsCDF[id].resize(bin + 1);
-    valid[id].resize(bin + 1);
-    for (unsigned int i = oldSize; i < populations[id].size(); i++) {
-      valid[id][i] = false;
+  }
+
+  // only the non-zero values need to be set in a new run
+  std::vector<sample_t> row; // p.m.f. of a run (sparse form)
+  for (unsigned int r = 0; r < h.runs; r++) {
+    const sample_t* x = h.getRun(r, row); // alias
+    newRun();
+    for (unsigned int j = 0; j < h.bins; j++) {
+      if (x[j] == 0)
+        continue;
+      nonZero++;
+      if (!sparse) {
+        pmf[(runs - 1) * bins + j] = x[j];
+      } else {
+        nzBins.push_back(j);
+        nzValues.push_back(x[j]);
+      }
     }
   }
-  valid[id][bin] = true;
-  populations[id][bin].addSample(x);
-  populationsCDF[id][bin].addSample(cumulative);
 }
 
-Population& DstMeasure::getPopulation(unsigned int id, unsigned int bin) {
-  if (id >= populations.size() || bin >= populations[id].size() ||
-      valid[id][bin] == false)
-    throw *this;
-  return populations[id][bin];
+void DstMeasure::Histogram::computeMoments() {
+  std::vector<sample_t> cdf(bins); // c.d.f. of a run
+  std::vector<sample_t> row;       // p.m.f. of a run (sparse form)
+  for (; last < runs; last++) {
+    const sample_t* x = getRun(last, row); // alias
+
+    // the cumulative values are computed as in the original order
+    sample_t cumulative = 0;
+    for (unsigned int j = 0; j < bins; j++) {
+      cumulative += x[j];
+      cdf[j] = cumulative;
+    }
+    for (unsigned int j = 0; j < bins; j++) {
+      if (valid[j] && last >= first[j]) {
+        pmfMoments[j].add(x[j]);
+        cdfMoments[j].add(cdf[j]);
+      }
+    }
+  }
+}
+
+void DstMeasure::Histogram::resetDerived() {
+  Population empty; // swapped with the derived populations
+  derivedLast = 0;
+  mean.swap(empty);
+  quantiles.clear();
+}
+
+void DstMeasure::grow(unsigned int id) {
+  if (id < histograms.size())
+    return;
+  unsigned int size = 2 * histograms.size();
+  if (size <= id)
+    size = id + 1;
+  std::vector<Histogram> table(size);
+  for (unsigned int i = 0; i < histograms.size(); i++)
+    table[i].swap(histograms[i]);
+  histograms.swap(table);
 }
 
-Population& DstMeasure::getPopulationCDF(unsigned int id, unsigned int bin) {
-  if (id >= populationsCDF.size() || bin >= populationsCDF[id].size() ||
-      valid[id][bin] == false)
+void DstMeasure::addSample(sample_t x, unsigned int id, unsigned int bin) {
+  grow(id);
+  Histogram& h = histograms[id]; // alias
+
+  // the first bin starts a new run, whose bins are all zero
+  if (bin == 0 || h.runs == 0)
+    h.newRun();
+  if (bin >= h.bins)
+    h.widen(bin + 1);
+  if (!h.valid[bin]) {
+    h.valid[bin] = true;
+    h.first[bin] = h.runs - 1;
+  }
+  if (x != 0)
+    h.nonZero++;
+  if (!h.sparse) {
+    h.pmf[(h.runs - 1) * h.bins + bin] = x;
+  } else if (x != 0) {
+    h.nzBins.push_back(bin);
+    h.nzValues.push_back(x);
+  }
+}
+
+DstMeasure::Histogram& DstMeasure::find(unsigned int id, unsigned int bin) {
+  if (id >= histograms.size() || bin >= histograms[id].bins ||
+      histograms[id].valid[bin] == false)
     throw *this;
-  return populationsCDF[id][bin];
+  return histograms[id];
+}
+
+const Moments& DstMeasure::getPMF(unsigned int id, unsigned int bin) {
+  Histogram& h = find(id, bin);
+  h.computeMoments();
+  return h.pmfMoments[bin];
+}
+
+const Moments& DstMeasure::getCDF(unsigned int id, unsigned int bin) {
+  Histogram& h = find(id, bin);
+  h.computeMoments();
+  return h.cdfMoments[bin];
+}
+
+void DstMeasure::dump(std::ostream& os,
+                      unsigned int  id,
+                      unsigned int  bin,
+                      bool          cdf) {
+  const Histogram&      h = find(id, bin);
+  std::vector<sample_t> row; // p.m.f. of a run (sparse form)
+  for (unsigned int r = h.first[bin]; r < h.runs; r++) {
+    const sample_t* x     = h.getRun(r, row); // alias
+    sample_t        value = x[bin];
+    if (cdf) {
+      value = 0;
+      for (unsigned int j = 0; j <= bin; j++)
+        value += x[j];
+    }
+    os << value;
+    if (r < h.runs - 1)
+      os << ", ";
+  }
 }
 
 bool DstMeasure::getValid(unsigned int id, unsigned int bin) {
-  if (id >= populations.size() || bin >= populations[id].size())
+  if (id >= histograms.size() || bin >= histograms[id].bins)
     throw *this;
-  return valid[id][bin];
+  return histograms[id].valid[bin];
 }
 
 unsigned int DstMeasure::getSize(unsigned int id) {
-  if (id >= populations.size())
+  if (id >= histograms.size())
     throw *this;
-  return populations[id].size();
+  return histograms[id].bins;
 }
 
-Population& DstMeasure::getMeanPopulation(unsigned int id) {
-  if (id >= populations.size())
+void DstMeasure::merge(const DstMeasure& m) {
+  if (m.binSizeSet)
+    setBinSize(m.binSize);
+  if (m.distLowerSet)
+    setDistLower(m.distLower);
+
+  for (unsigned int i = 0; i < m.histograms.size(); i++) {
+    if (m.histograms[i].runs == 0)
+      continue;
+    grow(i);
+    histograms[i].append(m.histograms[i]);
+  }
+}
+
+void DstMeasure::update(unsigned int id) {
+  if (id >= histograms.size())
     throw *this;
 
+  histograms[id].computeMoments();
   computeDerivedStatistics(id);
-  return meanPopulations[id];
 }
 
-Population& DstMeasure::getMedianPopulation(unsigned int id) {
-  if (id >= populations.size())
+Population& DstMeasure::getMeanPopulation(unsigned int id) {
+  if (id >= histograms.size())
     throw *this;
 
   computeDerivedStatistics(id);
-  return medianPopulations[id];
+  return histograms[id].mean;
 }
 
-Population& DstMeasure::getPercentile95Population(unsigned int id) {
-  if (id >= populations.size())
+Population& DstMeasure::getPercentilePopulation(unsigned int id,
+                                                double       level) {
+  if (id >= histograms.size())
+    throw *this;
+
+  std::vector<double>::const_iterator it =
+      std::lower_bound(levels.begin(), levels.end(), level);
+  if (it == levels.end() || *it != level)
     throw *this;
 
   computeDerivedStatistics(id);
-  return percentile95Populations[id];
+  return histograms[id].quantiles[it - levels.begin()];
 }
 
-Population& DstMeasure::getPercentile99Population(unsigned int id) {
-  if (id >= populations.size())
+void DstMeasure::addPercentile(double level) {
+  if (!(level > 0 && level < 100))
     throw *this;
 
-  computeDerivedStatistics(id);
-  return percentile99Populations[id];
+  std::vector<double>::iterator it =
+      std::lower_bound(levels.begin(), levels.end(), level);
+  if (it != levels.end() && *it == level)
+    return;
+  levels.insert(it, level);
+
+  // the runs already added are scanned again for all the levels
+  for (unsigned int i = 0; i < histograms.size(); i++)
+    histograms[i].resetDerived();
 }
 
 void DstMeasure::computeDerivedStatistics(unsigned int id) {
   // consistency check
-  if (id >= populations.size() || !binSizeSet || !distLowerSet)
+  if (id >= histograms.size() || !binSizeSet || !distLowerSet)
     throw *this;
+  Histogram& h = histograms[id]; // alias
+
+  if (h.quantiles.size() != levels.size())
+    h.quantiles.resize(levels.size());
+  std::vector<unsigned int> q(levels.size()); // bin of each quantile
+
+  // the runs are scanned only once, since the derived metrics are
+  // kept up to date
+  for (; h.derivedLast < h.runs; h.derivedLast++) {
+    // bins and values of the run: all of them, or the non-zero ones
+    const unsigned int* bin = NULL;
+    const sample_t*     x   = NULL;
+    unsigned int        n   = h.bins;
+    if (h.sparse) {
+      unsigned int begin;
+      unsigned int end;
+      h.pairs(h.derivedLast, begin, end);
+      bin = h.nzBins.data() + begin;
+      x   = h.nzValues.data() + begin;
+      n   = end - begin;
+    } else {
+      x = h.pmf.data() + h.derivedLast * h.bins;
+    }
 
-  // check if we need to reallocate the derived metrics
-  if (id >= derivedLast.size()) {
-    unsigned int oldSize = derivedLast.size();
-    if (derivedLast.size() == derivedLast.capacity()) {
-      const unsigned int n = derivedLast.size();
-      derivedLast.reserve(n + VECTOR_CHUNK_SIZE);
-      meanPopulations.reserve(n + VECTOR_CHUNK_SIZE);
-      medianPopulations.reserve(n + VECTOR_CHUNK_SIZE);
-      percentile95Populations.reserve(n + VECTOR_CHUNK_SIZE);
-      percentile99Populations.reserve(n + VECTOR_CHUNK_SIZE);
+    // mean
+    sample_t mean = 0.0;
+    for (unsigned int k = 0; k < n; k++)
+      mean += x[k] * (distLower + binSize * ((bin ? bin[k] : k) + 1));
+
+    // quantiles: the first bins where the c.d.f. exceeds them, all
+    // found in a single pass since the levels are in increasing order
+    unsigned int next       = 0; // next quantile to be found
+    sample_t     cumulative = 0.0;
+    for (unsigned int k = 0; k < n && next < levels.size(); k++) {
+      cumulative += x[k];
+      while (next < levels.size() && cumulative > levels[next] / 100.0)
+        q[next++] = bin ? bin[k] : k;
     }
-    derivedLast.resize(id + 1);
-    meanPopulations.resize(id + 1);
-    medianPopulations.resize(id + 1);
-    percentile95Populations.resize(id + 1);
-    percentile99Populations.resize(id + 1);
-    for (unsigned int i = oldSize; i < derivedLast.size(); i++) {
-      derivedLast[i] = 0;
+
+    // push back the derived values, 0 for the quantiles not reached
+    h.mean.addSample(mean);
+    for (unsigned int l = 0; l < levels.size(); l++)
+      h.quantiles[l].addSample(l < next ? distLower + binSize * (q[l] + 1)
+                                        : 0.0);
+  }
+}
+
+void DstMeasure::write(std::ostream& os) const {
+  put(os, binSize);
+  put(os, distLower);
+  const unsigned int flags = (binSizeSet ? 1 : 0) | (distLowerSet ? 2 : 0);
+  put(os, flags);
+  const unsigned int nlevels = levels.size();
+  put(os, nlevels);
+  for (unsigned int l = 0; l < levels.size(); l++)
+    put(os, levels[l]);
+
+  const unsigned int n = histograms.size();
+  put(os, n);
+  for (unsigned int i = 0; i < histograms.size(); i++) {
+    const Histogram& h = histograms[i]; // alias
+
+    // runs
+    put(os, h.bins);
+    put(os, h.runs);
+    for (unsigned int j = 0; j < h.bins; j++) {
+      const unsigned int first = h.valid[j] ? h.first[j] : UINT_MAX;
+      put(os, first);
+    }
+    const unsigned int sparse = h.sparse ? 1 : 0;
+    put(os, sparse);
+    if (h.sparse) {
+      const unsigned int pairs = h.nzBins.size();
+      put(os, pairs);
+      if (h.runs > 0)
+        os.write((const char*)&h.start[0], h.runs * sizeof(unsigned int));
+      if (pairs > 0) {
+        os.write((const char*)&h.nzBins[0], pairs * sizeof(unsigned int));
+        os.write((const char*)&h.nzValues[0], pairs * sizeof(sample_t));
+      }
+    } else if (!h.pmf.empty()) {
+      os.write((const char*)&h.pmf[0], h.pmf.size() * sizeof(sample_t));
+    }
+
+    // derived statistics, up to the run in derivedLast
+    put(os, h.derivedLast);
+    h.mean.write(os);
+    for (unsigned int l = 0; l < levels.size(); l++) {
+      if (l < h.quantiles.size())
+        h.quantiles[l].write(os);
+      else
+        Population().write(os);
     }
   }
+}
 
-  // we do not compute the derived metrics whether one of the following
-  // conditions is true:
-  // - there are no bins with index id
-  // - the derived metrics are up to date
-  if (populations[id].size() == 0 ||
-      populations[id][0].getSize() == derivedLast[id])
-    return;
+void DstMeasure::read(std::istream& is) {
+  unsigned int flags; // bin size and lower bound set
+  unsigned int n;     // number of indices
+  unsigned int bins;  // number of bins
+  unsigned int runs;  // number of runs
+  unsigned int first; // run of the first sample of a bin
 
-  //
-  // otherwise, let us compute them all
-  //
+  if (!get(is, binSize) || !get(is, distLower) || !get(is, flags))
+    throw *this;
+  binSizeSet   = (flags & 1) != 0;
+  distLowerSet = (flags & 2) != 0;
+  unsigned int nlevels; // number of percentile levels
+  if (!get(is, nlevels))
+    throw *this;
+  levels.resize(nlevels);
+  for (unsigned int l = 0; l < nlevels; l++) {
+    if (!get(is, levels[l]))
+      throw *this;
+  }
 
-  // in the loop below, i is the run index
-  for (unsigned int i = derivedLast[id]; i < populations[id][0].getSize();
-       i++) {
+  if (!get(is, n))
+    throw *this;
+  histograms.clear();
+  histograms.resize(n);
+  for (unsigned int i = 0; i < n; i++) {
+    Histogram& h = histograms[i]; // alias
 
-    // mean
-    sample_t mean  = 0.0;
-    bool     valid = true;
-    for (unsigned int j = 0; j < populations[id].size(); j++) {
-      mean += populations[id][j].getSample(valid, i) *
-              (distLower + binSize * (j + 1));
-      if (valid == false)
+    // runs, whose moments are computed again when needed
+    if (!get(is, bins) || !get(is, runs))
+      throw *this;
+    h.widen(bins);
+    h.runs = runs;
+    for (unsigned int j = 0; j < bins; j++) {
+      if (!get(is, first))
         throw *this;
+      h.valid[j] = first != UINT_MAX;
+      h.first[j] = h.valid[j] ? first : 0;
     }
+    unsigned int sparse; // 1 if the runs are in sparse form
+    unsigned int pairs;  // number of non-zero values
+    if (!get(is, sparse))
+      throw *this;
+    h.sparse = sparse != 0;
+    if (h.sparse) {
+      if (!get(is, pairs))
+        throw *this;
+      h.start.resize(runs);
+      h.nzBins.resize(pairs);
+      h.nzValues.resize(pairs);
+      if (runs > 0)
+        is.read((char*)&h.start[0], runs * sizeof(unsigned int));
+      if (pairs > 0) {
+        is.read((char*)&h.nzBins[0], pairs * sizeof(unsigned int));
+        is.read((char*)&h.nzValues[0], pairs * sizeof(sample_t));
+      }
+    } else {
+      h.pmf.resize((size_t)runs * bins);
+      if (!h.pmf.empty())
+        is.read((char*)&h.pmf[0], h.pmf.size() * sizeof(sample_t));
+      for (unsigned int j = 0; runs > 0 && j < bins; j++) {
+        if (h.pmf[(runs - 1) * bins + j] != 0)
+          h.nonZero++;
+      }
+    }
+
+    // derived statistics
+    if (!get(is, h.derivedLast) || !h.mean.read(is))
+      throw *this;
+    h.quantiles.resize(nlevels);
+    for (unsigned int l = 0; l < nlevels; l++) {
+      if (!h.quantiles[l].read(is))
+        throw *this;
+    }
+  }
+}
+
+//
+// class SktMeasure
+//
+
+void SktMeasure::addSketch(const Sketch& s, unsigned int id) {
+  if (id >= indices.size())
+    indices.resize(id + 1);
+  Index& x = indices[id]; // alias
+
+  // the first run sets the accuracy of the merged sketch
+  if (x.mean.getSize() == 0)
+    x.merged = Sketch(s.getAccuracy());
+  x.merged.merge(s);
+
+  if (x.quantiles.size() != levels.size())
+    x.quantiles.resize(levels.size());
+  x.mean.addSample(s.mean());
+  for (unsigned int l = 0; l < levels.size(); l++)
+    x.quantiles[l].addSample(s.quantile(levels[l] / 100.0));
+  runs++;
+}
+
+void SktMeasure::merge(const SktMeasure& m) {
+  if (m.levels != levels)
+    throw *this;
+
+  if (m.indices.size() > indices.size())
+    indices.resize(m.indices.size());
+  for (unsigned int i = 0; i < m.indices.size(); i++) {
+    const Index& y = m.indices[i]; // alias
+    Index&       x = indices[i];   // alias
+    if (y.mean.getSize() == 0)
+      continue;
+
+    // as in addSketch(), but with all the runs of y at once
+    if (x.mean.getSize() == 0)
+      x.merged = Sketch(y.merged.getAccuracy());
+    x.merged.merge(y.merged);
+
+    if (x.quantiles.size() != levels.size())
+      x.quantiles.resize(levels.size());
+    x.mean.merge(y.mean);
+    for (unsigned int l = 0; l < y.quantiles.size(); l++)
+      x.quantiles[l].merge(y.quantiles[l]);
+  }
+  runs += m.runs;
+}
+
+Population& SktMeasure::getMeanPopulation(unsigned int id) {
+  if (id >= indices.size())
+    throw *this;
+  return indices[id].mean;
+}
+
+Population& SktMeasure::getPercentilePopulation(unsigned int id,
+                                                double       level) {
+  if (id >= indices.size())
+    throw *this;
+
+  std::vector<double>::const_iterator it =
+      std::lower_bound(levels.begin(), levels.end(), level);
+  if (it == levels.end() || *it != level)
+    throw *this;
+
+  Index& x = indices[id]; // alias
+  if (x.quantiles.size() != levels.size())
+    x.quantiles.resize(levels.size());
+  return x.quantiles[it - levels.begin()];
+}
+
+const Sketch& SktMeasure::getSketch(unsigned int id) const {
+  if (id >= indices.size())
+    throw *this;
+  return indices[id].merged;
+}
+
+void SktMeasure::addPercentile(double level) {
+  if (!(level > 0 && level < 100))
+    throw *this;
+
+  std::vector<double>::iterator it =
+      std::lower_bound(levels.begin(), levels.end(), level);
+  if (it != levels.end() && *it == level)
+    return;
+
+  // the sketches of the runs already added are not stored
+  if (runs > 0)
+    throw *this;
+  levels.insert(it, level);
+}
 
-    // quantiles
-    double median       = 0.0;
-    double percentile95 = 0.0;
-    double percentile99 = 0.0;
-    for (int j = populationsCDF[id].size() - 1; j >= 0; j--) {
-      const sample_t x = populationsCDF[id][j].getSample(valid, i); // alias
-
-      if (x > 0.50)
-        median = distLower + binSize * (j + 1);
-      if (x > 0.95)
-        percentile95 = distLower + binSize * (j + 1);
-      if (x > 0.99)
-        percentile99 = distLower + binSize * (j + 1);
+void SktMeasure::write(std::ostream& os) const {
+  const unsigned int nlevels = levels.size();
+  put(os, nlevels);
+  for (unsigned int l = 0; l < levels.size(); l++)
+    put(os, levels[l]);
+  put(os, runs);
+
+  const unsigned int n = indices.size();
+  put(os, n);
+  for (unsigned int i = 0; i < indices.size(); i++) {
+    const Index& x = indices[i]; // alias
+    x.mean.write(os);
+    for (unsigned int l = 0; l < levels.size(); l++) {
+      if (l < x.quantiles.size())
+        x.quantiles[l].write(os);
+      else
+        Population().write(os);
     }
+    x.merged.write(os);
+  }
+}
+
+void SktMeasure::read(std::istream& is) {
+  unsigned int nlevels; // number of percentile levels
+  unsigned int n;       // number of indices
 
-    // push back the derived values
-    meanPopulations[id].addSample(mean);
-    medianPopulations[id].addSample(median);
-    percentile95Populations[id].addSample(percentile95);
-    percentile99Populations[id].addSample(percentile99);
+  if (!get(is, nlevels))
+    throw *this;
+  levels.resize(nlevels);
+  for (unsigned int l = 0; l < nlevels; l++) {
+    if (!get(is, levels[l]))
+      throw *this;
   }
+  if (!get(is, runs) || !get(is, n))
+    throw *this;
 
-  // update the last population size for the derived metrics computation
-  derivedLast[id] = populations[id][0].getSize();
+  indices.clear();
+  indices.resize(n);
+  for (unsigned int i = 0; i < n; i++) {
+    Index& x = indices[i]; // alias
+    if (!x.mean.read(is))
+      throw *this;
+    x.quantiles.resize(nlevels);
+    for (unsigned int l = 0; l < nlevels; l++) {
+      if (!x.quantiles[l].read(is))
+        throw *this;
+    }
+    if (!x.merged.read(is))
+      throw *this;
+  }
 }
 
 //
@@ -283,24 +1117,108 @@ void DstMeasure::computeDerivedStatistics(unsigned int id) {
 //
 
 void Metrics::addSample(std::string m, sample_t x, unsigned int id) {
-  avgMeasures[m].addSample(x, id);
+  getAvgMeasure(m).addSample(x, id);
 }
 
 void Metrics::addSample(std::string  m,
                         sample_t     x,
                         unsigned int id,
                         unsigned int bin) {
-  dstMeasures[m].addSample(x, id, bin);
+  getDstMeasure(m).addSample(x, id, bin);
 }
 
 void Metrics::setBinSize(std::string m, sample_t binSize) {
   // if ( dstMeasures.count(m) == 0 ) throw *this;  // XXX check
-  dstMeasures[m].setBinSize(binSize);
+  getDstMeasure(m).setBinSize(binSize);
 }
 
 void Metrics::setDistLower(std::string m, sample_t distLower) {
   // if ( dstMeasures.count(m) == 0 ) throw *this;  // XXX check
-  dstMeasures[m].setDistLower(distLower);
+  getDstMeasure(m).setDistLower(distLower);
+}
+
+void Metrics::addSketch(std::string m, const Sketch& s, unsigned int id) {
+  getSktMeasure(m).addSketch(s, id);
+}
+
+void Metrics::addPercentile(std::string m, double level) {
+  // the type of the measure is not known until its first run,
+  // hence the level is also added to the measures created later
+  percentiles[m].insert(level);
+  if (dstMeasures.count(m) == 1)
+    dstMeasures[m].addPercentile(level);
+  if (sktMeasures.count(m) == 1)
+    sktMeasures[m].addPercentile(level);
+}
+
+void Metrics::setStreaming(std::string m, unsigned int id) {
+  // as for the percentile levels, the index is also set in streaming
+  // mode in the measure created later
+  streamed[m].insert(id);
+  if (avgMeasures.count(m) == 1)
+    avgMeasures[m].setStreaming(id);
+}
+
+void Metrics::copySettings(const Metrics& m) {
+  percentiles = m.percentiles;
+  streamed    = m.streamed;
+}
+
+void Metrics::merge(Metrics& m) {
+  if (&m == this)
+    throw *this;
+
+  std::map<std::string, AvgMeasure>::const_iterator it;
+  for (it = m.avgMeasures.begin(); it != m.avgMeasures.end(); ++it)
+    getAvgMeasure(it->first).merge(it->second);
+
+  std::map<std::string, DstMeasure>::const_iterator jt;
+  for (jt = m.dstMeasures.begin(); jt != m.dstMeasures.end(); ++jt)
+    getDstMeasure(jt->first).merge(jt->second);
+
+  std::map<std::string, SktMeasure>::const_iterator kt;
+  for (kt = m.sktMeasures.begin(); kt != m.sktMeasures.end(); ++kt)
+    getSktMeasure(kt->first).merge(kt->second);
+
+  m.avgMeasures.clear();
+  m.dstMeasures.clear();
+  m.sktMeasures.clear();
+}
+
+AvgMeasure& Metrics::getAvgMeasure(const std::string& m) {
+  const bool  created = avgMeasures.count(m) == 0;
+  AvgMeasure& a       = avgMeasures[m];
+  if (created && streamed.count(m) == 1) {
+    const std::set<unsigned int>&          ids = streamed[m]; // alias
+    std::set<unsigned int>::const_iterator it;
+    for (it = ids.begin(); it != ids.end(); ++it)
+      a.setStreaming(*it);
+  }
+  return a;
+}
+
+DstMeasure& Metrics::getDstMeasure(const std::string& m) {
+  const bool  created = dstMeasures.count(m) == 0;
+  DstMeasure& d       = dstMeasures[m];
+  if (created && percentiles.count(m) == 1) {
+    const std::set<double>&          q = percentiles[m]; // alias
+    std::set<double>::const_iterator it;
+    for (it = q.begin(); it != q.end(); ++it)
+      d.addPercentile(*it);
+  }
+  return d;
+}
+
+SktMeasure& Metrics::getSktMeasure(const std::string& m) {
+  const bool  created = sktMeasures.count(m) == 0;
+  SktMeasure& k       = sktMeasures[m];
+  if (created && percentiles.count(m) == 1) {
+    const std::set<double>&          q = percentiles[m]; // alias
+    std::set<double>::const_iterator it;
+    for (it = q.begin(); it != q.end(); ++it)
+      k.addPercentile(*it);
+  }
+  return k;
 }
 
 bool Metrics::checkConfidence(std::set<std::string>& metrics,
@@ -314,21 +1232,92 @@ bool Metrics::checkConfidence(std::set<std::string>& metrics,
     if (metrics.count(it->first) == 0)
       continue;
 
-    AvgMeasure& m = it->second; // alias
-    m.restartPopulation();
-    for (unsigned int i = 0; i < m.getSize(); i++) {
-      bool        valid; // unused
-      Population& p     = m.getPopulation();
-      double      value = p.mean(valid);
-      double      conf  = p.confInterval(valid, cl);
-      if (p.getSize() == 1 || (value > 0 && (2.0 * conf) / value > th))
+    const AvgMeasure&          m  = it->second; // alias
+    AvgMeasure::const_iterator jt = m.begin();
+    for (; jt != m.end(); ++jt) {
+      bool   valid; // unused
+      double value = jt->mean(valid);
+      double conf  = jt->confInterval(valid, cl);
+      if (jt->getSize() == 1 || (value > 0 && (2.0 * conf) / value > th))
         return false;
-      m.nextPopulation();
     }
   }
   return true;
 }
 
+void Metrics::write(std::ostream& os) const {
+  unsigned int n = avgMeasures.size();
+  put(os, n);
+  std::map<std::string, AvgMeasure>::const_iterator it = avgMeasures.begin();
+  for (; it != avgMeasures.end(); ++it) {
+    writeName(os, it->first);
+    it->second.write(os);
+  }
+
+  n = dstMeasures.size();
+  put(os, n);
+  std::map<std::string, DstMeasure>::const_iterator jt = dstMeasures.begin();
+  for (; jt != dstMeasures.end(); ++jt) {
+    writeName(os, jt->first);
+    jt->second.write(os);
+  }
+
+  n = sktMeasures.size();
+  put(os, n);
+  std::map<std::string, SktMeasure>::const_iterator kt = sktMeasures.begin();
+  for (; kt != sktMeasures.end(); ++kt) {
+    writeName(os, kt->first);
+    kt->second.write(os);
+  }
+}
+
+void Metrics::read(std::istream& is) {
+  std::map<std::string, AvgMeasure> avg;  // averaged measures read
+  std::map<std::string, DstMeasure> dst;  // distribution measures read
+  std::map<std::string, SktMeasure> skt;  // sketch measures read
+  unsigned int                      n;    // number of measures
+  std::string                       name; // name of the measure
+
+  if (!get(is, n))
+    throw *this;
+  for (unsigned int i = 0; i < n; i++) {
+    if (!readName(is, name))
+      throw *this;
+    avg[name].read(is);
+  }
+
+  if (!get(is, n))
+    throw *this;
+  for (unsigned int i = 0; i < n; i++) {
+    if (!readName(is, name))
+      throw *this;
+    dst[name].read(is);
+  }
+
+  if (!get(is, n))
+    throw *this;
+  for (unsigned int i = 0; i < n; i++) {
+    if (!readName(is, name))
+      throw *this;
+    skt[name].read(is);
+  }
+
+  avgMeasures.swap(avg);
+  dstMeasures.swap(dst);
+  sktMeasures.swap(skt);
+
+  // the populations read are in streaming mode if they were written so,
+  // but the indices not read yet must be set again
+  std::map<std::string, std::set<unsigned int>>::const_iterator it;
+  for (it = streamed.begin(); it != streamed.end(); ++it) {
+    if (avgMeasures.count(it->first) == 0)
+      continue;
+    std::set<unsigned int>::const_iterator jt;
+    for (jt = it->second.begin(); jt != it->second.end(); ++jt)
+      avgMeasures[it->first].setStreaming(*jt);
+  }
+}
+
 void Metrics::dump(std::string savedir, std::string hdr, double cl, bool dist) {
   bool valid;
 
@@ -347,14 +1336,7 @@ void Metrics::dump(std::string savedir, std::string hdr, double cl, bool dist) {
       throw *this;
 
     // print the values
-    AvgMeasure& m = it->second; // alias
-    m.restartPopulation();
-    for (unsigned int i = 0; i < m.getSize(); i++) {
-      Population& p = m.getPopulation();
-      os << hdr << "," << m.getPopulationId() << "," << p.mean(valid) << ","
-         << p.confInterval(valid, cl) << '\n';
-      m.nextPopulation();
-    }
+    printAvg(os, it->second, &hdr, cl);
 
     // close the output file
     os.close();
@@ -367,6 +1349,7 @@ void Metrics::dump(std::string savedir, std::string hdr, double cl, bool dist) {
   std::map<std::string, DstMeasure>::iterator jt = dstMeasures.begin();
   for (; jt != dstMeasures.end(); jt++) {
     DstMeasure& m = jt->second; // alias
+    updateAll(m);
 
     for (unsigned int i = 0; i < m.getSize(); i++) {
 
@@ -387,8 +1370,8 @@ void Metrics::dump(std::string savedir, std::string hdr, double cl, bool dist) {
             continue;
           sample_t x = m.getDistLower() + (j + 1.0) * m.getBinSize();
           os << hdr << "," << i << "," << x << ","
-             << m.getPopulation(i, j).mean(valid) << ","
-             << m.getPopulation(i, j).confInterval(valid, cl) << '\n';
+             << m.getPMF(i, j).mean(valid) << ","
+             << m.getPMF(i, j).confInterval(valid, cl) << '\n';
         }
 
         // close the output file
@@ -412,95 +1395,51 @@ void Metrics::dump(std::string savedir, std::string hdr, double cl, bool dist) {
             continue;
           sample_t x = m.getDistLower() + (j + 1.0) * m.getBinSize();
           os << hdr << "," << i << "," << x << ","
-             << m.getPopulationCDF(i, j).mean(valid) << ","
-             << m.getPopulationCDF(i, j).confInterval(valid, cl) << '\n';
+             << m.getCDF(i, j).mean(valid) << ","
+             << m.getCDF(i, j).confInterval(valid, cl) << '\n';
         }
 
         // close the output file
         os.close();
       }
 
-      // median
-      if (m.getMedianPopulation(i).getSize() > 0) {
-        // open the output file
-        std::ofstream     os;
-        std::string       filename;
-        std::stringstream buf;
-        buf << savedir << jt->first << "_q50.dat";
-        getline(buf, filename);
-        os.open(filename.c_str(), std::ios::out | std::ios::app);
-        if (!os.is_open())
-          throw *this;
-
-        // print the median value
-        os << hdr << "," << i << "," << m.getMedianPopulation(i).mean(valid)
-           << "," << m.getMedianPopulation(i).confInterval(valid, cl) << '\n';
-
-        // close the output file
-        os.close();
-      }
-
-      // mean
-      if (m.getMeanPopulation(i).getSize() > 0) {
-        // open the output file
-        std::ofstream     os;
-        std::string       filename;
-        std::stringstream buf;
-        buf << savedir << jt->first << "_avg.dat";
-        getline(buf, filename);
-        os.open(filename.c_str(), std::ios::out | std::ios::app);
-        if (!os.is_open())
-          throw *this;
-
-        // print the median value
-        os << hdr << "," << i << "," << m.getMeanPopulation(i).mean(valid)
-           << "," << m.getMeanPopulation(i).confInterval(valid, cl) << '\n';
+      // derived statistics
+      if (!dumpDerived(m, i, savedir + jt->first, hdr, cl))
+        throw *this;
+    }
+  }
 
-        // close the output file
-        os.close();
-      }
+  // print all the sketch measures
+  std::map<std::string, SktMeasure>::iterator kt = sktMeasures.begin();
+  for (; kt != sktMeasures.end(); kt++) {
+    SktMeasure& m = kt->second; // alias
 
-      // 95th percentile
-      if (m.getPercentile95Population(i).getSize() > 0) {
-        // open the output file
-        std::ofstream     os;
-        std::string       filename;
-        std::stringstream buf;
-        buf << savedir << jt->first << "_95.dat";
-        getline(buf, filename);
-        os.open(filename.c_str(), std::ios::out | std::ios::app);
-        if (!os.is_open())
-          throw *this;
-
-        // print the median value
-        os << hdr << "," << i << ","
-           << m.getPercentile95Population(i).mean(valid) << ","
-           << m.getPercentile95Population(i).confInterval(valid, cl) << '\n';
+    for (unsigned int i = 0; i < m.getSize(); i++) {
+      if (!m.getValid(i))
+        continue;
 
-        // close the output file
-        os.close();
-      }
+      // derived statistics, as for distribution measures
+      if (!dumpDerived(m, i, savedir + kt->first, hdr, cl))
+        throw *this;
 
-      // 99th percentile
-      if (m.getPercentile99Population(i).getSize() > 0) {
-        // open the output file
-        std::ofstream     os;
-        std::string       filename;
-        std::stringstream buf;
-        buf << savedir << jt->first << "_99.dat";
-        getline(buf, filename);
-        os.open(filename.c_str(), std::ios::out | std::ios::app);
-        if (!os.is_open())
-          throw *this;
+      // open the output file
+      std::ofstream     os;
+      std::string       filename;
+      std::stringstream buf;
+      buf << savedir << kt->first << "_merged.dat";
+      getline(buf, filename);
+      os.open(filename.c_str(), std::ios::out | std::ios::app);
+      if (!os.is_open())
+        throw *this;
 
-        // print the median value
-        os << hdr << "," << i << ","
-           << m.getPercentile99Population(i).mean(valid) << ","
-           << m.getPercentile99Population(i).confInterval(valid, cl) << '\n';
+      // print the percentiles of all the runs merged
+      const std::vector<double>& levels = m.getPercentiles(); // alias
+      for (unsigned int l = 0; l < levels.size(); l++)
+        os << hdr << "," << i << "," << levels[l] << ","
+           << m.getSketch(i).quantile(levels[l] / 100.0) << '\n';
 
-        // close the output file
-        os.close();
-      }
+      // close the output file
+      os.close();
     }
   }
 }
@@ -515,16 +1454,7 @@ void Metrics::dump(std::ostream& os, double cl, bool dist) {
     os << "averaged measure = " << it->first << '\n';
 
     // print the measure values
-    AvgMeasure& m = it->second; // alias
-    m.restartPopulation();
-    for (unsigned int i = 0; i < m.getSize(); i++) {
-      Population& p = m.getPopulation();
-      os << "(" << m.getPopulationId() << ") = ";
-      p.dump(os);
-      os << " [" << p.mean(valid) << ", " << p.confInterval(valid, cl) << "]"
-         << '\n';
-      m.nextPopulation();
-    }
+    printAvg(os, it->second, NULL, cl);
   }
 
   if (!dist)
@@ -534,6 +1464,7 @@ void Metrics::dump(std::ostream& os, double cl, bool dist) {
   std::map<std::string, DstMeasure>::iterator jt = dstMeasures.begin();
   for (; jt != dstMeasures.end(); jt++) {
     DstMeasure& m = jt->second; // alias
+    updateAll(m);
 
     os << "distribution measure = " << jt->first << '\n';
     for (unsigned int i = 0; i < m.getSize(); i++) {
@@ -541,9 +1472,9 @@ void Metrics::dump(std::ostream& os, double cl, bool dist) {
       for (unsigned int j = 0; j < m.getSize(i); j++) {
         if (m.getValid(i, j)) {
           os << "(" << i << ", " << j << ") = ";
-          m.getPopulation(i, j).dump(os);
-          os << " [" << m.getPopulation(i, j).mean(valid) << ", "
-             << m.getPopulation(i, j).confInterval(valid, cl) << "]" << '\n';
+          m.dump(os, i, j, false);
+          os << " [" << m.getPMF(i, j).mean(valid) << ", "
+             << m.getPMF(i, j).confInterval(valid, cl) << "]" << '\n';
         }
       }
 
@@ -551,45 +1482,35 @@ void Metrics::dump(std::ostream& os, double cl, bool dist) {
       for (unsigned int j = 0; j < m.getSize(i); j++) {
         if (m.getValid(i, j)) {
           os << "(" << i << ", " << j << ") = ";
-          m.getPopulationCDF(i, j).dump(os);
-          os << " [" << m.getPopulationCDF(i, j).mean(valid) << ", "
-             << m.getPopulationCDF(i, j).confInterval(valid, cl) << "]" << '\n';
+          m.dump(os, i, j, true);
+          os << " [" << m.getCDF(i, j).mean(valid) << ", "
+             << m.getCDF(i, j).confInterval(valid, cl) << "]" << '\n';
         }
       }
 
-      if (m.getMedianPopulation(i).getSize() > 0) {
-        os << "(" << i << ") "
-           << "median = ";
-        m.getMedianPopulation(i).dump(os);
-        os << " [" << m.getMedianPopulation(i).mean(valid) << ", "
-           << m.getMedianPopulation(i).confInterval(valid, cl) << "]" << '\n';
-      }
-
-      if (m.getMeanPopulation(i).getSize() > 0) {
-        os << "(" << i << ") "
-           << "mean   = ";
-        m.getMeanPopulation(i).dump(os);
-        os << " [" << m.getMeanPopulation(i).mean(valid) << ", "
-           << m.getMeanPopulation(i).confInterval(valid, cl) << "]" << '\n';
-      }
+      // derived statistics
+      dumpDerived(os, m, i, cl);
+    }
+  }
 
-      if (m.getPercentile95Population(i).getSize() > 0) {
-        os << "(" << i << ") "
-           << "q95    = ";
-        m.getPercentile95Population(i).dump(os);
-        os << " [" << m.getPercentile95Population(i).mean(valid) << ", "
-           << m.getPercentile95Population(i).confInterval(valid, cl) << "]"
-           << '\n';
-      }
+  // print all the sketch measures
+  std::map<std::string, SktMeasure>::iterator kt = sktMeasures.begin();
+  for (; kt != sktMeasures.end(); kt++) {
+    SktMeasure& m = kt->second; // alias
 
-      if (m.getPercentile99Population(i).getSize() > 0) {
-        os << "(" << i << ") "
-           << "q99    = ";
-        m.getPercentile99Population(i).dump(os);
-        os << " [" << m.getPercentile99Population(i).mean(valid) << ", "
-           << m.getPercentile99Population(i).confInterval(valid, cl) << "]"
-           << '\n';
-      }
+    os << "sketch measure = " << kt->first << '\n';
+    for (unsigned int i = 0; i < m.getSize(); i++) {
+      if (!m.getValid(i))
+        continue;
+
+      // derived statistics, then the percentiles of all the runs merged
+      dumpDerived(os, m, i, cl);
+      const Sketch&              sketch = m.getSketch(i);     // alias
+      const std::vector<double>& levels = m.getPercentiles(); // alias
+      os << "(" << i << ") merged = " << sketch.getCount() << " values,";
+      for (unsigned int l = 0; l < levels.size(); l++)
+        os << " q" << levels[l] << " " << sketch.quantile(levels[l] / 100.0);
+      os << '\n';
     }
   }
 }
@@ -33,6 +33,8 @@
 #define __MEASURE_MEASURE_H
 
 #include <config.h>
+#include <samplestore.h>
+#include <sketch.h>
 #include <stat.h>
 
 #include <iostream>
@@ -41,15 +43,119 @@
 #include <string>
 #include <vector>
 
+//! Running moments of a set of samples, which are not stored.
+/*!
+  The mean and the sum of the squared deviations from the mean are
+  updated as samples are added (Welford's method), hence the mean and
+  the confidence interval are computed in constant time.
+  */
+class Moments
+{
+  //! Number of samples.
+  unsigned int n;
+  //! Running mean of the samples.
+  double avg;
+  //! Running sum of the squared deviations from the mean.
+  double m2;
+
+ public:
+  //! Create the moments of an empty set.
+  Moments()
+      : n(0)
+      , avg(0)
+      , m2(0) {
+  }
+  //! Create the moments from their values.
+  Moments(unsigned int n_, double avg_, double m2_)
+      : n(n_)
+      , avg(avg_)
+      , m2(m2_) {
+  }
+
+  //! Add a sample.
+  void add(double x) {
+    n++;
+    const double delta = x - avg;
+    avg += delta / n;
+    m2 += delta * (x - avg);
+  }
+  //! Add the samples of another set, whose moments are given.
+  /*!
+    Pairwise update of Chan et al., which gives the same moments as
+    adding the samples one by one, up to rounding errors.
+    */
+  void merge(const Moments& m);
+  //! Return the number of samples.
+  unsigned int getSize() const {
+    return n;
+  }
+  //! Return the mean.
+  /*!
+    The validity bit is false if there are no samples.
+    */
+  double mean(bool& valid) const {
+    valid = n > 0;
+    return valid ? avg : -1.0;
+  }
+  //! Return the sum of the squared deviations from the mean.
+  double getSquares() const {
+    return m2;
+  }
+  //! Return the confidence interval.
+  double confInterval(bool& valid, double cl) const {
+    return Stat::confInterval(valid, n, n > 1 ? m2 / (n - 1.0) : 0.0, cl);
+  }
+  //! Return true if the confidence interval is small enough.
+  /*!
+    The confidence interval at the confidence level cl must not exceed
+    th times half the mean. Sets with mean <= 0 are accepted.
+    */
+  bool confident(double cl, double th) const;
+};
+
 //! A Population is a set of samples collected from the same sensor.
+/*!
+  The moments of the samples are updated as samples are added (see
+  Moments), hence the mean and the confidence interval are computed in
+  constant time. The result of the last confidence check is cached
+  until a new sample is added.
+
+  The const functions can be called concurrently by any number of
+  threads, provided that no thread modifies the population meanwhile;
+  the confidence check is const, but it updates the cache, hence it
+  must not be called concurrently on the same population.
+
+  The samples are stored in chunks (see SampleStore), hence they are
+  not copied when the population grows. In streaming mode, only the
+  moments are kept, hence the memory does not grow with the number of
+  samples, but the samples themselves cannot be retrieved.
+  */
 class Population
 {
-  //! Vector of samples. It is the population itself.
-  std::vector<sample_t> population;
+  //! Samples. It is the population itself. Empty in streaming mode.
+  SampleStore population;
+  //! Running moments of the samples.
+  Moments moments;
+  //! True if only the moments of the samples are kept.
+  bool streaming;
+
+  //! Number of samples at the time of the last confidence check.
+  mutable unsigned int checkedSize;
+  //! Confidence level of the last confidence check.
+  mutable double checkedCL;
+  //! Threshold of the last confidence check.
+  mutable double checkedThreshold;
+  //! Result of the last confidence check.
+  mutable bool checkedResult;
 
  public:
   //! Create an empty population.
-  Population() {
+  Population()
+      : streaming(false)
+      , checkedSize(0)
+      , checkedCL(0)
+      , checkedThreshold(0)
+      , checkedResult(false) {
   }
   //! The destructor does nothing.
   ~Population() {
@@ -57,57 +163,244 @@ class Population
 
   //! Return the number of elements.
   unsigned int getSize() const {
-    return population.size();
+    return moments.getSize();
   }
   //! Add a sample to the population.
   void addSample(sample_t x);
+  //! Add the samples of another population.
+  /*!
+    The samples are only kept if both populations keep them, otherwise
+    the population switches to streaming mode.
+    */
+  void merge(const Population& p);
+  //! Switch to streaming mode, releasing the samples stored so far.
+  void setStreaming();
+  //! Return true if only the moments of the samples are kept.
+  bool getStreaming() const {
+    return streaming;
+  }
   //! Return the i-th sample.
+  /*!
+    The validity bit is false in streaming mode.
+    */
   sample_t getSample(bool& valid, unsigned int i);
+  //! Return the samples, to be iterated over span by span.
+  /*!
+    There are none in streaming mode.
+    */
+  const SampleStore& getSamples() const {
+    return population;
+  }
   //! Return the mean of the population.
-  double mean(bool& valid) {
-    return Stat::mean(valid, population);
+  /*!
+    The validity bit is false if the population is empty.
+    */
+  double mean(bool& valid) const {
+    return moments.mean(valid);
+  }
+  //! Return the sum of the squared deviations from the mean.
+  double getSquares() const {
+    return moments.getSquares();
   }
   //! Return the confidence interval of the population.
-  double confInterval(bool& valid, double cl) {
-    return Stat::confInterval(valid, population, cl);
+  double confInterval(bool& valid, double cl) const {
+    return moments.confInterval(valid, cl);
   }
+  //! Return true if the confidence interval is small enough.
+  /*!
+    The confidence interval at the confidence level cl must not exceed
+    th times half the mean. Populations with mean <= 0 are accepted.
+    */
+  bool confident(double cl, double th) const;
+
+  //! Write the running moments and the samples, if kept, to a binary stream.
+  void write(std::ostream& os) const;
+  //! Exchange the samples and the moments with another population.
+  void swap(Population& p);
+
+  //! Read a population written by write(), replacing the current one.
+  /*!
+    Return false on premature end of file.
+    */
+  bool read(std::istream& is);
 
   //! Debug function to print the values to an output stream.
-  void dump(std::ostream& os);
+  /*!
+    In streaming mode, only the number of samples is printed.
+    */
+  void dump(std::ostream& os) const;
 };
 
 //! An AvgMeasure is a set of populations for averaged metrics.
+/*!
+  The populations are indexed by id in a dense table, which holds
+  all the ids below its size, hence finding the population of an id
+  takes constant time. Ids far beyond the number of populations would
+  leave too many holes in the dense table, hence they are kept in a
+  sparse map until the dense table grows past them. The ids in the
+  sparse map are always larger than those in the dense table, so that
+  the populations are visited in id order by scanning the dense table
+  first, then the map.
+
+  The populations of the ids set with setStreaming() are created in
+  streaming mode (see Population).
+
+  The populations are visited either with a const_iterator, or with
+  restartPopulation() and nextPopulation(), which move a cursor kept in
+  the measure itself. Any number of threads can visit the populations
+  with const_iterators at the same time, each with its own, and read
+  them with their const functions, provided that no thread adds
+  populations or samples meanwhile. The cursor is shared, hence it
+  must only be used by one thread.
+  */
 class AvgMeasure : public Object
 {
-  //! Array of populations.
-  std::map<unsigned int, Population> populations;
-  //! TODO
+  //! Populations with id smaller than the size of the table.
+  std::vector<Population> dense;
+  //! True if the population with the same id in the dense table exists.
+  std::vector<bool> present;
+  //! Populations with id not smaller than the size of the dense table.
+  std::map<unsigned int, Population> sparse;
+  //! Number of populations.
+  unsigned int count;
+  //! Current population: its id if in the dense table.
+  unsigned int pos;
+  //! Current population, if not in the dense table.
   std::map<unsigned int, Population>::iterator it;
+  //! Ids of the populations in streaming mode.
+  std::set<unsigned int> streamed;
+
+  //! Return the population of a given id, which is created if needed.
+  Population& find(unsigned int id);
+  //! As find(), but new populations are in streaming mode if needed.
+  Population& create(unsigned int id);
+  //! Move pos to the first population in the dense table from pos.
+  void skip() {
+    while (pos < dense.size() && !present[pos])
+      pos++;
+  }
 
  public:
+  //! Read-only iterator over the populations, in id order.
+  class const_iterator
+  {
+    friend class AvgMeasure;
+
+    //! Measure visited.
+    const AvgMeasure* owner;
+    //! Current population: its id if in the dense table.
+    unsigned int pos;
+    //! Current population, if not in the dense table.
+    std::map<unsigned int, Population>::const_iterator jt;
+
+    //! Create an iterator at the first population from pos or jt.
+    const_iterator(const AvgMeasure*                                  m,
+                   unsigned int                                       p,
+                   std::map<unsigned int, Population>::const_iterator j)
+        : owner(m)
+        , pos(p)
+        , jt(j) {
+      skip();
+    }
+    //! Move pos to the first population in the dense table from pos.
+    void skip() {
+      while (pos < owner->dense.size() && !owner->present[pos])
+        pos++;
+    }
+
+   public:
+    //! Return the id of the current population.
+    unsigned int id() const {
+      return pos < owner->dense.size() ? pos : jt->first;
+    }
+    //! Return the current population.
+    const Population& operator*() const {
+      return pos < owner->dense.size() ? owner->dense[pos] : jt->second;
+    }
+    //! Return the current population.
+    const Population* operator->() const {
+      return &**this;
+    }
+    //! Move to the next population.
+    const_iterator& operator++() {
+      if (pos < owner->dense.size()) {
+        pos++;
+        skip();
+      } else {
+        ++jt;
+      }
+      return *this;
+    }
+    //! Return true if both iterators are at the same population.
+    bool operator==(const const_iterator& x) const {
+      return pos == x.pos && jt == x.jt;
+    }
+    //! Return true if the iterators are at different populations.
+    bool operator!=(const const_iterator& x) const {
+      return !(*this == x);
+    }
+  };
+
   //! Create an emptry AvgMeasure.
   AvgMeasure()
-      : Object("AvgMeasure") {
+      : Object("AvgMeasure")
+      , count(0)
+      , pos(0) {
   }
   //! Do nothing.
   ~AvgMeasure() {
   }
 
   //! Add a sample to a population.
-  void addSample(sample_t x, unsigned int id);
+  void addSample(sample_t x, unsigned int id) {
+    if (id < dense.size() && present[id])
+      dense[id].addSample(x);
+    else
+      create(id).addSample(x);
+  }
+  //! Add the populations of another measure, index by index.
+  /*!
+    The new populations are in streaming mode if set here.
+    */
+  void merge(const AvgMeasure& m);
+  //! Keep only the moments of the samples of a given index.
+  void setStreaming(unsigned int id);
   //! Return the population of a given index.
   Population& getPopulation(unsigned int id);
+  //! Return the population of a given index.
+  const Population& getPopulation(unsigned int id) const;
+
+  //! Return an iterator at the population with the smallest id.
+  const_iterator begin() const {
+    return const_iterator(this, 0, sparse.begin());
+  }
+  //! Return an iterator past the population with the largest id.
+  const_iterator end() const {
+    return const_iterator(this, dense.size(), sparse.end());
+  }
 
-  Population&  getPopulation();
-  void         nextPopulation();
-  void         restartPopulation();
+  //! Return the population at the cursor.
+  Population& getPopulation();
+  //! Move the cursor to the next population.
+  void nextPopulation();
+  //! Move the cursor to the population with the smallest id.
+  void restartPopulation();
+  //! Return the id of the population at the cursor.
   unsigned int getPopulationId();
   //! Return true if the population with a given index exists.
-  bool getValid(unsigned int id);
+  bool getValid(unsigned int id) const;
   //! Return the number of populations in this measure.
   unsigned int getSize() const {
-    return populations.size();
+    return count;
   }
+
+  //! Write all the populations to a binary stream.
+  void write(std::ostream& os) const;
+  //! Read the populations written by write(), replacing the current ones.
+  /*!
+    An exception is thrown on premature end of file.
+    */
+  void read(std::istream& is);
 };
 
 //! A DstMeasure is a set of populations for distribution metrics.
@@ -121,22 +414,94 @@ class AvgMeasure : public Object
 
   The bin size and the mininmum data structure must be set before
   computing the quantile values. Also, samples must be added in
-  bin order. If they are not, then the cumulative values will not
-  be meaningful.
+  bin order, and each run starts with bin 0.
+
+  Only the probability mass function is stored, as a contiguous array
+  of runs with one value per bin, for each index. The moments of the
+  probability mass and cumulative distribution functions of each bin
+  are updated when they are requested, by scanning the runs added
+  since then.
+
+  Wide distributions with mostly empty bins, e.g., long-tailed delays,
+  are switched to a sparse form, where only the non-zero (bin, value)
+  pairs of each run are stored. The quantiles and the mean are derived
+  from the pairs directly.
   */
 class DstMeasure : public Object
 {
-  //! Array of array of populations.
-  std::vector<std::vector<Population>> populations;
-  //! Array of array of populations. Cumulative wrt the previous bins.
-  /*!
-    Note that the populations and populationsCDF always have the
-    same size and structure. Thus, the valid structure is meaningful
-    for both these data structures.
-    */
-  std::vector<std::vector<Population>> populationsCDF;
-  //! Bit array to check if the i-th entry of populations is valid.
-  std::vector<std::vector<bool>> valid;
+  //! Distribution of a given index.
+  struct Histogram {
+    //! Number of bins, i.e., number of values of each run in pmf.
+    unsigned int bins;
+    //! Number of runs.
+    unsigned int runs;
+    //! Probability mass function of all the runs, one after the other.
+    std::vector<sample_t> pmf;
+    //! True if the runs are stored as non-zero (bin, value) pairs.
+    bool sparse;
+    //! Number of non-zero values of the current run.
+    unsigned int nonZero;
+    //! Position of the first pair of each run (sparse form).
+    std::vector<unsigned int> start;
+    //! Bins of the non-zero values of all the runs (sparse form).
+    std::vector<unsigned int> nzBins;
+    //! Non-zero values of all the runs (sparse form).
+    std::vector<sample_t> nzValues;
+    //! Bit array to check if the i-th bin is valid.
+    std::vector<bool> valid;
+    //! Run of the first sample of each valid bin.
+    std::vector<unsigned int> first;
+
+    //! Number of runs in pmfMoments and cdfMoments.
+    unsigned int last;
+    //! Moments of the probability mass function of each bin.
+    std::vector<Moments> pmfMoments;
+    //! Moments of the cumulative distribution function of each bin.
+    std::vector<Moments> cdfMoments;
+
+    //! Number of runs in the derived statistics.
+    unsigned int derivedLast;
+    //! Population of average values.
+    Population mean;
+    //! Populations of the percentiles, in the same order as levels.
+    std::vector<Population> quantiles;
+
+    //! Create an empty distribution.
+    Histogram()
+        : bins(0)
+        , runs(0)
+        , sparse(false)
+        , nonZero(0)
+        , last(0)
+        , derivedLast(0) {
+    }
+    //! Exchange the content with another distribution.
+    void swap(Histogram& h);
+    //! Change the number of bins of all the runs.
+    void widen(unsigned int size);
+    //! Start a new run, switching to the sparse form if worth it.
+    void newRun();
+    //! Return the pairs of a run, from begin to end (sparse form).
+    void pairs(unsigned int r, unsigned int& begin, unsigned int& end) const {
+      begin = start[r];
+      end   = r + 1 < runs ? start[r + 1] : nzBins.size();
+    }
+    //! Return all the values of a run, using row if needed.
+    const sample_t* getRun(unsigned int r, std::vector<sample_t>& row) const;
+    //! Append the runs of another distribution after the last run.
+    /*!
+      The result is the same as if the samples of the runs had been
+      added here.
+      */
+    void append(const Histogram& h);
+    //! Add the runs since last to the moments of the bins.
+    void computeMoments();
+    //! Drop the derived statistics, which are computed again when needed.
+    void resetDerived();
+  };
+
+  //! Distributions, by index.
+  std::vector<Histogram> histograms;
   //! Bin size.
   sample_t binSize;
   //! Distribution lower bound.
@@ -145,22 +510,25 @@ class DstMeasure : public Object
   bool binSizeSet;
   //! True if the distribution lower bound has been set.
   bool distLowerSet;
+  //! Percentile levels of the derived statistics, in increasing order.
+  std::vector<double> levels;
 
-  //! Populations of average values.
-  std::vector<Population> meanPopulations;
-  //! Populations of median values.
-  std::vector<Population> medianPopulations;
-  //! Populations of 95th percentile values.
-  std::vector<Population> percentile95Populations;
-  //! Populations of 99th percentile values.
-  std::vector<Population> percentile99Populations;
-  //! Record the last size of the bins populations.
-  std::vector<unsigned int> derivedLast;
+  //! Return the distribution of a valid index/bin.
+  Histogram& find(unsigned int id, unsigned int bin);
+  //! Grow the array of distributions up to an index, without copying runs.
+  void grow(unsigned int id);
 
  public:
   //! Create an emptry DstMeasure.
   DstMeasure()
-      : Object("DstMeasure") {
+      : Object("DstMeasure")
+      , binSize(0)
+      , distLower(0)
+      , binSizeSet(false)
+      , distLowerSet(false) {
+    levels.push_back(50);
+    levels.push_back(95);
+    levels.push_back(99);
   }
   //! Do nothing.
   ~DstMeasure() {
@@ -168,27 +536,47 @@ class DstMeasure : public Object
 
   //! Add a sample to a population bin.
   void addSample(sample_t x, unsigned int id, unsigned int bin);
-  //! Return the population of a given index/bin.
-  Population& getPopulation(unsigned int id, unsigned int bin);
-  //! Return the CDF population of a given index/bin.
-  Population& getPopulationCDF(unsigned int id, unsigned int bin);
+  //! Append the runs of another measure, index by index.
+  /*!
+    The bin size and the lower bound are taken from the other measure,
+    if set there. The derived statistics are computed again as needed,
+    with the percentile levels of this measure.
+    */
+  void merge(const DstMeasure& m);
+  //! Return the moments of the p.m.f. of a given index/bin.
+  const Moments& getPMF(unsigned int id, unsigned int bin);
+  //! Return the moments of the c.d.f. of a given index/bin.
+  const Moments& getCDF(unsigned int id, unsigned int bin);
+  //! Print the values of the p.m.f. or c.d.f. of a given index/bin.
+  void dump(std::ostream& os, unsigned int id, unsigned int bin, bool cdf);
   //! Return the mean population.
   Population& getMeanPopulation(unsigned int id);
-  //! Return the mediam population.
-  Population& getMedianPopulation(unsigned int id);
-  //! Return the 95th percentile population.
-  Population& getPercentile95Population(unsigned int id);
-  //! Return the 99th percentile population.
-  Population& getPercentile99Population(unsigned int id);
+  //! Return the population of a percentile, which must have been added.
+  Population& getPercentilePopulation(unsigned int id, double level);
+  //! Add a percentile level (in percent) to the derived statistics.
+  /*!
+    The median, 95th and 99th percentiles are always present.
+    */
+  void addPercentile(double level);
+  //! Return the percentile levels, in increasing order.
+  const std::vector<double>& getPercentiles() const {
+    return levels;
+  }
 
   //! Compute the derived statistics (mean, quantiles) if not already done.
   void computeDerivedStatistics(unsigned int id);
+  //! Bring the moments and the derived statistics of an index up to date.
+  /*!
+    Only the given index is modified, hence different indices can be
+    updated by different threads at the same time.
+    */
+  void update(unsigned int id);
 
   //! Return true if the population with a given index exists.
   bool getValid(unsigned int id, unsigned int bin);
   //! Return the number of populations in this measure.
   unsigned int getSize() const {
-    return populations.size();
+    return histograms.size();
   }
   //! Return the number of bins in the given index.
   unsigned int getSize(unsigned int id);
@@ -210,13 +598,110 @@ class DstMeasure : public Object
   sample_t getDistLower() const {
     return distLower;
   }
+
+  //! Write all the populations, including the derived ones, to a stream.
+  void write(std::ostream& os) const;
+  //! Read the populations written by write(), replacing the current ones.
+  /*!
+    An exception is thrown on premature end of file.
+    */
+  void read(std::istream& is);
 };
 
-//! A Metrics object contain all the AvgMeasure and DstMeasure objects.
+//! A SktMeasure contains the sketches of a distribution, by index.
+/*!
+  The sketches are not stored: each run only adds its mean and its
+  quantiles to the populations of the index, which give their
+  confidence intervals across the runs, and it is merged into a
+  sketch of all the runs, which gives the quantiles of all the
+  values. Hence the memory needed does not depend on the number of
+  values in the runs, and the percentile levels must be added before
+  the first run.
+  */
+class SktMeasure : public Object
+{
+  //! Statistics of a given index.
+  struct Index {
+    //! Population of the mean values of the runs.
+    Population mean;
+    //! Populations of the percentiles, in the same order as levels.
+    std::vector<Population> quantiles;
+    //! Merge of the sketches of all the runs.
+    Sketch merged;
+  };
+
+  //! Statistics, by index.
+  std::vector<Index> indices;
+  //! Percentile levels of the derived statistics, in increasing order.
+  std::vector<double> levels;
+  //! Number of runs added, over all the indices.
+  unsigned int runs;
+
+ public:
+  //! Create an empty SktMeasure.
+  SktMeasure()
+      : Object("SktMeasure")
+      , runs(0) {
+    levels.push_back(50);
+    levels.push_back(95);
+    levels.push_back(99);
+  }
+  //! Do nothing.
+  ~SktMeasure() {
+  }
+
+  //! Add the sketch of a run to a given index.
+  void addSketch(const Sketch& s, unsigned int id);
+  //! Add the runs of another measure, index by index.
+  /*!
+    An exception is thrown if the percentile levels are not the same.
+    */
+  void merge(const SktMeasure& m);
+  //! Return the mean population.
+  Population& getMeanPopulation(unsigned int id);
+  //! Return the population of a percentile, which must have been added.
+  Population& getPercentilePopulation(unsigned int id, double level);
+  //! Return the merge of the sketches of all the runs.
+  const Sketch& getSketch(unsigned int id) const;
+  //! Add a percentile level (in percent) to the derived statistics.
+  /*!
+    The median, 95th and 99th percentiles are always present. An
+    exception is thrown if a new level is added after the first run.
+    */
+  void addPercentile(double level);
+  //! Return the percentile levels, in increasing order.
+  const std::vector<double>& getPercentiles() const {
+    return levels;
+  }
+
+  //! Return true if the index has at least one run.
+  bool getValid(unsigned int id) const {
+    return id < indices.size() && indices[id].mean.getSize() > 0;
+  }
+  //! Return the number of indices in this measure.
+  unsigned int getSize() const {
+    return indices.size();
+  }
+
+  //! Write all the statistics to a stream.
+  void write(std::ostream& os) const;
+  //! Read the statistics written by write(), replacing the current ones.
+  /*!
+    An exception is thrown on premature end of file.
+    */
+  void read(std::istream& is);
+};
+
+//! A Metrics object contain all the AvgMeasure, DstMeasure and SktMeasure.
 class Metrics : public Object
 {
   std::map<std::string, AvgMeasure> avgMeasures;
   std::map<std::string, DstMeasure> dstMeasures;
+  std::map<std::string, SktMeasure> sktMeasures;
+  //! Percentile levels of the distribution and sketch measures, by name.
+  std::map<std::string, std::set<double>> percentiles;
+  //! Indices of the averaged measures in streaming mode, by name.
+  std::map<std::string, std::set<unsigned int>> streamed;
 
  public:
   //! Create an empty Metrics object.
@@ -235,19 +720,58 @@ class Metrics : public Object
   void setBinSize(std::string m, sample_t binSize);
   //! Set the lower bound of a distribution measure.
   void setDistLower(std::string m, sample_t distLower);
+  //! Add the sketch of a run to a sketch measure.
+  void addSketch(std::string m, const Sketch& s, unsigned int id);
+  //! Add a percentile level to a distribution or sketch measure.
+  void addPercentile(std::string m, double level);
+  //! Keep only the moments of an index of an averaged measure.
+  void setStreaming(std::string m, unsigned int id);
+  //! Use the percentile levels and the streaming indices of another object.
+  /*!
+    The settings only apply to the measures created later.
+    */
+  void copySettings(const Metrics& m);
+  //! Move all the measures of another Metrics object into this one.
+  /*!
+    The runs of the other measures are added after the runs here, as
+    if they had been added here in the first place, but for the
+    rounding of the moments of the populations, which are merged (see
+    Moments::merge()). The other object is left without measures, but
+    with its settings.
+    */
+  void merge(Metrics& m);
 
   //! Return the set of average measures.
   std::map<std::string, AvgMeasure>& getAvgMeasures() {
     return avgMeasures;
   }
+  //! Return an averaged measure, created if needed.
+  AvgMeasure& getAvgMeasure(const std::string& m);
   //! Return the set of distribution measures.
   std::map<std::string, DstMeasure>& getDstMeasures() {
     return dstMeasures;
   }
+  //! Return a distribution measure, created if needed.
+  DstMeasure& getDstMeasure(const std::string& m);
+  //! Return a sketch measure, created if needed.
+  SktMeasure& getSktMeasure(const std::string& m);
+  //! Return the set of sketch measures.
+  std::map<std::string, SktMeasure>& getSktMeasures() {
+    return sktMeasures;
+  }
 
   //! Check the confidence level of a set of averaged metrics.
   bool checkConfidence(std::set<std::string>& metrics, double cl, double th);
 
+  //! Write all the measures to a binary stream.
+  void write(std::ostream& os) const;
+  //! Read the measures written by write(), replacing the current ones.
+  /*!
+    An exception is thrown on premature end of file, in which case the
+    current measures are left untouched.
+    */
+  void read(std::istream& is);
+
   //! Print the content of the Metrics object into files on a directory.
   void dump(std::string savedir, std::string hdr, double cl, bool dist);
 
@@ -36,6 +36,7 @@
 #include <iostream>
 #endif // DEBUG
 
+#include <atomic>
 #include <string>
 
 //! Object superclass. All other classes should inherit from this class.
@@ -50,8 +51,9 @@ class Object
   //! Default construction only allowed.
   Object(std::string name)
       : className(name) {
-    static unsigned int newId = 0;
-    id                        = ++newId;
+    // objects may be created by several threads, see ShardedMetrics
+    static std::atomic<unsigned int> newId(0);
+    id = ++newId;
 #ifdef DEBUG
     std::cerr << "+ " << className << " (" << id << ")\n";
 #endif // DEBUG
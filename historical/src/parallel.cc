@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: parallel.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the Parallel class
+*/
+
+#include <parallel.h>
+
+#include <exception>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include <stdint.h>
+
+namespace {
+
+//! Run a task over a range of items, keeping the exception thrown, if any.
+void work(Parallel::Task*     task,
+          unsigned int        first,
+          unsigned int        last,
+          std::exception_ptr* error) {
+  try {
+    task->run(first, last);
+  } catch (...) {
+    *error = std::current_exception();
+  }
+}
+
+} // namespace
+
+void Parallel::run(unsigned int n, Task& task) {
+  unsigned int threads = std::thread::hardware_concurrency();
+  if (threads > n / grain)
+    threads = n / grain;
+  if (threads <= 1) {
+    task.run(0, n);
+    return;
+  }
+
+  // range t is from t * n / threads to (t + 1) * n / threads
+  std::vector<unsigned int> bounds(threads + 1);
+  for (unsigned int t = 0; t <= threads; t++)
+    bounds[t] = (uint64_t)t * n / threads;
+
+  std::vector<std::exception_ptr> errors(threads);
+  std::vector<std::thread>        workers;
+  workers.reserve(threads - 1);
+  try {
+    for (unsigned int t = 1; t < threads; t++)
+      workers.push_back(
+          std::thread(work, &task, bounds[t], bounds[t + 1], &errors[t]));
+  } catch (const std::system_error&) {
+    // the ranges of the threads which could not be started are run here
+  }
+  work(&task, bounds[0], bounds[1], &errors[0]);
+  for (unsigned int t = workers.size() + 1; t < threads; t++)
+    work(&task, bounds[t], bounds[t + 1], &errors[t]);
+  for (unsigned int t = 0; t < workers.size(); t++)
+    workers[t].join();
+
+  for (unsigned int t = 0; t < threads; t++) {
+    if (errors[t])
+      std::rethrow_exception(errors[t]);
+  }
+}
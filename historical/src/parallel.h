@@ -0,0 +1,82 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: parallel.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           split of a loop over independent items among threads
+*/
+
+#ifndef __MEASURE_PARALLEL_H
+#define __MEASURE_PARALLEL_H
+
+#include <config.h>
+#include <object.h>
+
+//! Run a loop over independent items on all the available cores.
+/*!
+  The items are split into contiguous ranges, one per thread, and the
+  calling thread takes the first range itself. No more threads are
+  started than needed for each to have at least grain items, hence
+  short loops run in the calling thread only, as well as the ranges of
+  the threads which cannot be started.
+
+  The threads are started at each call, hence it is only worth it for
+  loops doing real work on each item, e.g., Metrics::dump(), and not
+  for those run after each simulation.
+
+  The items must be independent: the task must not modify any data
+  shared by two ranges. An exception thrown by the task in any thread
+  is thrown again by run(), after all the threads have finished.
+  */
+class Parallel : public Object
+{
+  //! Minimum number of items of each thread.
+  unsigned int grain;
+
+ public:
+  //! Body of the loop.
+  struct Task {
+    //! Do nothing.
+    virtual ~Task() {
+    }
+    //! Process the items from first to last (excluded).
+    virtual void run(unsigned int first, unsigned int last) = 0;
+  };
+
+  //! Create a loop with at least grain items per thread.
+  Parallel(unsigned int g = PARALLEL_MIN_ITEMS)
+      : Object("Parallel")
+      , grain(g > 0 ? g : 1) {
+  }
+  //! Do nothing.
+  ~Parallel() {
+  }
+
+  //! Run the task over n items, returning when all of them are done.
+  void run(unsigned int n, Task& task);
+};
+
+#endif // __MEASURE_PARALLEL_H
@@ -0,0 +1,139 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: protocol.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the Dictionary class
+*/
+
+#include <codec.h>
+#include <protocol.h>
+#include <string.h>
+
+//! Maximum length of a varint of 64 bits, in bytes.
+#define MAX_VARINT 10
+
+unsigned int Dictionary::add(MetricType   type,
+                             std::string  name,
+                             sample_t     binSize,
+                             sample_t     distLower,
+                             unsigned int bins,
+                             sample_t     accuracy) {
+  DictEntry e;
+  e.type      = type;
+  e.name      = name;
+  e.binSize   = binSize;
+  e.distLower = distLower;
+  e.bins      = bins;
+  e.accuracy  = accuracy;
+  e.avg       = NULL;
+  e.dst       = NULL;
+  e.skt       = NULL;
+  entries.push_back(e);
+  return entries.size() - 1;
+}
+
+void Dictionary::write(std::string& out) const {
+  std::string body;
+  Codec::putVarint(body, entries.size());
+  for (unsigned int i = 0; i < entries.size(); i++) {
+    const DictEntry& e = entries[i]; // alias
+    body.push_back(e.type == METRIC_AVG ? 0 : e.type == METRIC_DIST ? 1 : 2);
+    Codec::putVarint(body, e.name.size());
+    body.append(e.name);
+    if (e.type == METRIC_DIST) {
+      body.append((const char*)&e.binSize, sizeof(e.binSize));
+      body.append((const char*)&e.distLower, sizeof(e.distLower));
+      Codec::putVarint(body, e.bins);
+    } else if (e.type == METRIC_SKETCH) {
+      body.append((const char*)&e.accuracy, sizeof(e.accuracy));
+    }
+  }
+  Codec::putVarint(out, body.size());
+  out.append(body);
+}
+
+void Dictionary::read(const char* buf, size_t n) {
+  const char* end = buf + n;
+  uint64_t    m;   // number of metrics
+  uint64_t    len; // length of the name
+  uint64_t    bin; // number of bins
+
+  entries.clear();
+  buf = Codec::getVarint(buf, end, m);
+  for (uint64_t i = 0; buf != 0 && i < m; i++) {
+    if (buf == end || (*buf != 0 && *buf != 1 && *buf != 2))
+      throw *this;
+    const MetricType type = (*buf == 0)   ? METRIC_AVG
+                            : (*buf == 1) ? METRIC_DIST
+                                          : METRIC_SKETCH;
+    buf                   = Codec::getVarint(buf + 1, end, len);
+    if (buf == 0 || len >= MAX_METRIC_NAME || len > (uint64_t)(end - buf))
+      throw *this;
+    const std::string name(buf, len);
+    buf += len;
+    if (type == METRIC_AVG) {
+      add(type, name);
+      continue;
+    }
+    if (type == METRIC_SKETCH) {
+      sample_t accuracy;
+      if (end - buf < (ptrdiff_t)sizeof(accuracy))
+        throw *this;
+      memcpy(&accuracy, buf, sizeof(accuracy));
+      buf += sizeof(accuracy);
+      if (!(accuracy >= SKETCH_MIN_ACCURACY && accuracy < 1))
+        throw *this;
+      add(type, name, 0, 0, 0, accuracy);
+      continue;
+    }
+    sample_t binSize, distLower;
+    if (end - buf < (ptrdiff_t)(2 * sizeof(sample_t)))
+      throw *this;
+    memcpy(&binSize, buf, sizeof(binSize));
+    memcpy(&distLower, buf + sizeof(binSize), sizeof(distLower));
+    buf = Codec::getVarint(buf + 2 * sizeof(sample_t), end, bin);
+    if (buf == 0 || bin > 0xffffffff)
+      throw *this;
+    add(type, name, binSize, distLower, bin);
+  }
+  if (buf != end)
+    throw *this;
+}
+
+size_t Dictionary::messageLength(const char* buf, size_t n, size_t& header) {
+  uint64_t    len; // length of the message, excluding the length field
+  const char* p = Codec::getVarint(buf, buf + n, len);
+  if (p == 0) {
+    if (n < MAX_VARINT)
+      return 0; // the length field itself is not complete
+    throw Dictionary();
+  }
+  header = p - buf;
+  if (len > n - header)
+    return 0;
+  return header + len;
+}
@@ -0,0 +1,188 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: protocol.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           metric dictionary of the compact communication protocol
+*/
+
+/*
+        communication protocol v2 (compact) NS2 -> measure program
+
+        unsigned int = UIN
+        double = DBL
+        varint = VAR (see codec.h)
+        char = CHR
+
+        The client selects v2 by sending a hello as the first bytes of
+        the connection, after the list of saved run identifiers and go
+        (see server.h). Otherwise, the protocol in input.h (v1) is used.
+
+        hello, once per connection:
+
+        type  data
+        UIN   PROTOCOL_MAGIC
+        UIN   PROTOCOL_VERSION = 2
+
+        dictionary, once per connection, right after the hello:
+
+        type  data
+        VAR   length of the dictionary, in bytes, excluding this field
+        VAR   number of metrics = m
+ |-CHR   metric type: 0 = averaged, 1 = distribution, 2 = sketch
+ |	VAR   length of the name of the metric = lenj (without '\0')
+j|	CHR   name of the metric, of length lenj
+ |	DBL   bin size                                 -| distribution
+ |	DBL   lower bound of the distribution           | metrics only
+ |	VAR   number of bins bj                         -|
+ |-DBL   relative accuracy                         -| sketch metrics only
+
+        then, for each run:
+
+        type  data
+        VAR   length of the run, in bytes, excluding this field
+        VAR   run identifier
+        VAR   no. of averaged metrics
+ |-VAR   metric j, as the position in the dictionary (from 0)
+ |	VAR   no. of indices of metric j = nj
+j|	VAR   index of the i-th sample, zigzag delta from the previous -| nj
+ |-DBL   i-th sample of metric j (i=0,1,..,nj-1)                   -| nj
+   VAR   no. of distribution metrics
+ |-VAR   metric j, as the position in the dictionary (from 0)
+ |	VAR   no. of indices of metric j = mj
+j|	VAR   index of the i-th distribution, as above                 -| mj
+ |-DBL   bins of the i-th distribution, bj samples each            -| mj
+   VAR   no. of sketch metrics, omitted if there are none
+ |-VAR   metric j, as the position in the dictionary (from 0)
+ |	VAR   no. of indices of metric j = kj
+ |	VAR   index of the i-th sketch, as above                       -| kj
+j|	DBL   sum of the values of the i-th sketch                     -|
+ |	DBL   count of its values not greater than 0                    |
+ |	VAR   no. of non-empty buckets = ci                              | kj
+ |	VAR   ci keys of the buckets, zigzag delta from the previous     |
+ |-DBL   ci counts of the buckets                                  -|
+
+        Runs are stored in the save file in the v1 format.
+*/
+
+#ifndef __MEASURE_PROTOCOL_H
+#define __MEASURE_PROTOCOL_H
+
+#include <config.h>
+#include <configuration.h>
+#include <measure.h>
+#include <object.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+//! Metric in the dictionary of the compact protocol.
+struct DictEntry {
+  //! Metric type: METRIC_AVG, METRIC_DIST or METRIC_SKETCH.
+  MetricType type;
+  //! Metric name.
+  std::string name;
+  //! Bin size, distribution metrics only.
+  sample_t binSize;
+  //! Distribution lower bound, distribution metrics only.
+  sample_t distLower;
+  //! Number of bins, distribution metrics only.
+  unsigned int bins;
+  //! Relative accuracy, sketch metrics only.
+  sample_t accuracy;
+
+  //! Cached descriptor of each index of an averaged metric, set by Input.
+  /*!
+    The descriptor is NULL if the index is not relevant, as in dstDsc.
+    */
+  std::map<unsigned int, const MetricDescAvg*> avgDsc;
+  //! Cached descriptor of each index of a distribution or sketch metric.
+  std::map<unsigned int, const MetricDescDst*> dstDsc;
+  //! Cached averaged measure, set by Input.
+  AvgMeasure* avg;
+  //! Cached distribution measure, set by Input.
+  DstMeasure* dst;
+  //! Cached sketch measure, set by Input.
+  SktMeasure* skt;
+};
+
+//! Dictionary of the metrics of a connection using the compact protocol.
+class Dictionary : public Object
+{
+  //! Metrics, in the order of the dictionary.
+  std::vector<DictEntry> entries;
+
+ public:
+  //! Create an empty dictionary.
+  Dictionary()
+      : Object("Dictionary") {
+  }
+  //! Do nothing.
+  ~Dictionary() {
+  }
+
+  //! Add a metric and return its position in the dictionary.
+  unsigned int add(MetricType   type,
+                   std::string  name,
+                   sample_t     binSize   = 0,
+                   sample_t     distLower = 0,
+                   unsigned int bins      = 0,
+                   sample_t     accuracy  = 0);
+  //! Return the number of metrics.
+  unsigned int size() const {
+    return entries.size();
+  }
+  //! Return the metric at a given position.
+  DictEntry& operator[](unsigned int i) {
+    return entries[i];
+  }
+  //! Return the metric at a given position.
+  const DictEntry& operator[](unsigned int i) const {
+    return entries[i];
+  }
+
+  //! Append the dictionary to a buffer, including the length field.
+  void write(std::string& out) const;
+  //! Read a dictionary, excluding the length field, of n bytes.
+  /*!
+    The previous content of the dictionary is replaced. An exception is
+    thrown if the dictionary is malformed.
+    */
+  void read(const char* buf, size_t n);
+
+  //! Return the length of the message at the beginning of buf.
+  /*!
+    Messages are the dictionary and the runs, preceded by their length.
+    Return 0 if the message is not complete in the first n bytes of buf,
+    otherwise the length of the message, including the length field,
+    which is returned in header. An exception is thrown if the length
+    field is malformed.
+    */
+  static size_t messageLength(const char* buf, size_t n, size_t& header);
+};
+
+#endif // __MEASURE_PROTOCOL_H
@@ -0,0 +1,162 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: runqueue.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the RunQueue class
+*/
+
+#include <runqueue.h>
+
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace {
+
+//! Wait until *word != value, or a wake-up.
+void futexWait(std::atomic<uint32_t>& word, uint32_t value) {
+  ::syscall(SYS_futex,
+            (uint32_t*)&word,
+            FUTEX_WAIT_PRIVATE,
+            value,
+            NULL,
+            NULL,
+            0);
+}
+
+//! Wake up the thread waiting on word, if any.
+void futexWake(std::atomic<uint32_t>& word) {
+  ::syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAKE_PRIVATE, 1, NULL, NULL, 0);
+}
+
+} // namespace
+
+RunQueue::RunQueue(unsigned int size)
+    : Object("RunQueue")
+    , slots(size > 0 ? size : 1)
+    , head(0)
+    , dataSeq(0)
+    , consumerWaiting(0)
+    , closed(0)
+    , tail(0)
+    , finished(0)
+    , spaceSeq(0)
+    , producerWaiting(0)
+    , stopped(0) {
+}
+
+bool RunQueue::push(std::string& run) {
+  const uint64_t h = head.load(std::memory_order_relaxed);
+  for (;;) {
+    if (h - tail.load(std::memory_order_acquire) < slots.size())
+      break;
+    if (isStopped())
+      return false;
+
+    // sleep, unless the consumer has finished a run in the meanwhile
+    const uint32_t seq = spaceSeq.load();
+    producerWaiting.store(1);
+    if (h - tail.load() == slots.size() && !isStopped())
+      futexWait(spaceSeq, seq);
+    producerWaiting.store(0);
+  }
+
+  slots[h % slots.size()].swap(run);
+  run.clear();
+
+  // publish the run, and wake up the consumer if it may be waiting
+  head.store(h + 1, std::memory_order_release);
+  dataSeq.fetch_add(1);
+  if (consumerWaiting.load() != 0)
+    futexWake(dataSeq);
+  return true;
+}
+
+bool RunQueue::wait(unsigned int lag) {
+  const uint64_t h = head.load(std::memory_order_relaxed);
+  for (;;) {
+    if (isStopped())
+      return false;
+    if (h - finished.load(std::memory_order_acquire) <= lag)
+      return true;
+
+    // sleep, unless the consumer has finished a run in the meanwhile
+    const uint32_t seq = spaceSeq.load();
+    producerWaiting.store(1);
+    if (h - finished.load() > lag && !isStopped())
+      futexWait(spaceSeq, seq);
+    producerWaiting.store(0);
+  }
+}
+
+void RunQueue::close() {
+  closed.store(1);
+  dataSeq.fetch_add(1);
+  futexWake(dataSeq);
+}
+
+bool RunQueue::pop(std::string& run) {
+  const uint64_t t = tail.load(std::memory_order_relaxed);
+  for (;;) {
+    if (head.load(std::memory_order_acquire) != t)
+      break;
+    // no runs: return if the producer has closed the queue
+    if (closed.load() != 0) {
+      if (head.load() == t)
+        return false;
+      continue;
+    }
+
+    // sleep, unless the producer has pushed a run in the meanwhile
+    const uint32_t seq = dataSeq.load();
+    consumerWaiting.store(1);
+    if (head.load() == t && closed.load() == 0)
+      futexWait(dataSeq, seq);
+    consumerWaiting.store(0);
+  }
+
+  run.swap(slots[t % slots.size()]);
+  slots[t % slots.size()].clear();
+  tail.store(t + 1, std::memory_order_release);
+  return true;
+}
+
+void RunQueue::done() {
+  finished.store(finished.load(std::memory_order_relaxed) + 1,
+                 std::memory_order_release);
+
+  // wake up the producer if it may be waiting
+  spaceSeq.fetch_add(1);
+  if (producerWaiting.load() != 0)
+    futexWake(spaceSeq);
+}
+
+void RunQueue::stop() {
+  stopped.store(1);
+  spaceSeq.fetch_add(1);
+  futexWake(spaceSeq);
+}
@@ -0,0 +1,129 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: runqueue.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           lock-free queue of runs between two threads
+*/
+
+#ifndef __MEASURE_RUNQUEUE_H
+#define __MEASURE_RUNQUEUE_H
+
+#include <config.h>
+#include <object.h>
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include <stdint.h>
+
+//! Single-producer single-consumer queue of runs, without locks.
+/*!
+  The producer is the thread which reads runs from the simulator, the
+  consumer is the thread which computes the statistics. Runs are moved
+  in and out of a fixed number of slots, and the producer and the
+  consumer only share the positions of the queue, which are atomic and
+  on separate cache lines. As in ShmRing, a thread sleeps on a futex
+  only when it has nothing to do, and it is woken up only if it is
+  actually sleeping.
+
+  The consumer marks each run as finished after processing it, so that
+  the producer can bound the number of runs which have been read but
+  whose statistics are not yet known (see wait()). The decision to stop
+  the simulation is published by the consumer with stop().
+  */
+class RunQueue : public Object
+{
+  //! Slots, indexed by position modulo their number.
+  std::vector<std::string> slots;
+
+  //! Number of runs pushed, written by the producer only.
+  alignas(64) std::atomic<uint64_t> head;
+  //! Incremented at each push, to wake up the consumer.
+  std::atomic<uint32_t> dataSeq;
+  //! Not zero if the consumer may be sleeping.
+  std::atomic<uint32_t> consumerWaiting;
+  //! Not zero if the producer will not push any more runs.
+  std::atomic<uint32_t> closed;
+
+  //! Number of runs popped, written by the consumer only.
+  alignas(64) std::atomic<uint64_t> tail;
+  //! Number of runs finished, written by the consumer only.
+  std::atomic<uint64_t> finished;
+  //! Incremented when a run is finished, to wake up the producer.
+  std::atomic<uint32_t> spaceSeq;
+  //! Not zero if the producer may be sleeping.
+  std::atomic<uint32_t> producerWaiting;
+  //! Not zero if the simulation must stop.
+  std::atomic<uint32_t> stopped;
+
+ public:
+  //! Create a queue with the given number of slots (at least one).
+  RunQueue(unsigned int size);
+  //! Do nothing.
+  ~RunQueue() {
+  }
+
+  //
+  // producer
+  //
+
+  //! Push a run, whose content is moved into the queue.
+  /*!
+    Wait while the queue is full. Return false, without pushing the run,
+    if the queue is full and stopped.
+    */
+  bool push(std::string& run);
+  //! Wait until no more than lag runs pushed are not finished.
+  /*!
+    Return false if the queue is stopped, possibly while waiting.
+    */
+  bool wait(unsigned int lag);
+  //! No more runs will be pushed.
+  void close();
+  //! Return true if the consumer has stopped the simulation.
+  bool isStopped() const {
+    return stopped.load() != 0;
+  }
+
+  //
+  // consumer
+  //
+
+  //! Pop the next run, whose content is moved into run.
+  /*!
+    Wait while the queue is empty. Return false if the queue is empty
+    and closed.
+    */
+  bool pop(std::string& run);
+  //! Mark the last run popped as finished.
+  void done();
+  //! Stop the simulation.
+  void stop();
+};
+
+#endif // __MEASURE_RUNQUEUE_H
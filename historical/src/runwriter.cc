@@ -0,0 +1,330 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: runwriter.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the RunWriter class
+*/
+
+#include <codec.h>
+#include <runwriter.h>
+
+#include <errno.h>
+#include <limits.h>
+#include <unistd.h>
+
+namespace {
+
+//! Read exactly n bytes. Return false on end of file or error.
+bool readAll(int fd, void* buf, size_t n) {
+  char* p = (char*)buf;
+  while (n > 0) {
+    const ssize_t ret = ::read(fd, p, n);
+    if (ret < 0 && errno == EINTR)
+      continue;
+    if (ret <= 0)
+      return false;
+    p += ret;
+    n -= ret;
+  }
+  return true;
+}
+
+//! Return an iovec pointing to n bytes of buf from offset.
+struct iovec slice(const std::string& buf, size_t offset, size_t n) {
+  struct iovec v;
+  v.iov_base = (void*)(buf.data() + offset);
+  v.iov_len  = n;
+  return v;
+}
+
+} // namespace
+
+RunWriter::RunWriter(int f, unsigned int v)
+    : Object("RunWriter")
+    , fd(f)
+    , version(v)
+    , started(false)
+    , inRun(false)
+    , id(0) {
+  if (version != 1 && version != PROTOCOL_VERSION)
+    throw *this;
+}
+
+unsigned int RunWriter::add(MetricType   type,
+                            std::string  name,
+                            sample_t     binSize,
+                            sample_t     distLower,
+                            unsigned int bins,
+                            sample_t     accuracy) {
+  // the dictionary cannot change after it has been emitted
+  if (started || name.size() >= MAX_METRIC_NAME)
+    throw *this;
+
+  Metric m;
+  m.bins  = (type == METRIC_AVG) ? 1 : (type == METRIC_DIST) ? bins : 0;
+  m.count = 0;
+  m.last  = 0;
+
+  // header of the metric in the format of input.h, but the no. of indices
+  const unsigned int len = name.size() + 1;
+  m.prefix.append((const char*)&len, sizeof(len));
+  m.prefix.append(name.c_str(), len);
+  if (type == METRIC_DIST) {
+    m.prefix.append((const char*)&binSize, sizeof(binSize));
+    m.prefix.append((const char*)&distLower, sizeof(distLower));
+    m.prefix.append((const char*)&bins, sizeof(bins));
+  } else if (type == METRIC_SKETCH) {
+    m.prefix.append((const char*)&accuracy, sizeof(accuracy));
+  }
+
+  metrics.push_back(m);
+  return dictionary.add(type, name, binSize, distLower, bins, accuracy);
+}
+
+unsigned int RunWriter::avgMetric(std::string name) {
+  return add(METRIC_AVG, name, 0, 0, 0, 0);
+}
+
+unsigned int RunWriter::dstMetric(std::string  name,
+                                  sample_t     binSize,
+                                  sample_t     distLower,
+                                  unsigned int bins) {
+  return add(METRIC_DIST, name, binSize, distLower, bins, 0);
+}
+
+unsigned int RunWriter::sktMetric(std::string name, sample_t accuracy) {
+  // check the accuracy now, rather than when the sketches are added
+  Sketch check(accuracy);
+  return add(METRIC_SKETCH, name, 0, 0, 0, accuracy);
+}
+
+void RunWriter::beginRun(unsigned int i) {
+  if (inRun)
+    throw *this;
+  inRun = true;
+  id    = i;
+}
+
+RunWriter::Metric& RunWriter::addIndex(unsigned int handle,
+                                       unsigned int index) {
+  if (!inRun || handle >= metrics.size())
+    throw *this;
+  Metric& m = metrics[handle]; // alias
+
+  if (m.count == 0)
+    used[dictionary[handle].type].push_back(handle);
+  if (version == 1) {
+    m.samples.append((const char*)&index, sizeof(index));
+  } else {
+    const int64_t delta = (int64_t)index - (m.count == 0 ? 0 : m.last);
+    Codec::putVarint(m.indices, ((uint64_t)delta << 1) ^ (delta >> 63));
+    m.last = index;
+  }
+  m.count++;
+  return m;
+}
+
+void RunWriter::add(unsigned int    handle,
+                    unsigned int    index,
+                    const sample_t* x) {
+  Metric& m = addIndex(handle, index); // alias
+  m.samples.append((const char*)x, m.bins * sizeof(sample_t));
+}
+
+void RunWriter::sketch(unsigned int  handle,
+                       unsigned int  index,
+                       const Sketch& s) {
+  if (handle >= metrics.size() || dictionary[handle].type != METRIC_SKETCH ||
+      dictionary[handle].accuracy != s.getAccuracy())
+    throw *this;
+  Metric& m = addIndex(handle, index); // alias
+
+  if (version == 1) {
+    s.encode(m.samples);
+    return;
+  }
+
+  // as in version 1, but with the keys encoded as zigzag deltas
+  std::vector<int>    keys;
+  std::vector<double> counts;
+  s.buckets(keys, counts);
+  const double sum  = s.getSum();
+  const double zero = s.getZero();
+  m.samples.append((const char*)&sum, sizeof(sum));
+  m.samples.append((const char*)&zero, sizeof(zero));
+  Codec::putVarint(m.samples, keys.size());
+  int64_t last = 0; // previous key
+  for (unsigned int k = 0; k < keys.size(); k++) {
+    const int64_t delta = (int64_t)keys[k] - last;
+    Codec::putVarint(m.samples, ((uint64_t)delta << 1) ^ (delta >> 63));
+    last = keys[k];
+  }
+  if (!counts.empty())
+    m.samples.append((const char*)&counts[0], counts.size() * sizeof(double));
+}
+
+void RunWriter::endRun() {
+  if (!inRun)
+    throw *this;
+
+  // the section of the sketch metrics is omitted if there are none
+  const unsigned int types = used[METRIC_SKETCH].empty() ? 2 : 3;
+
+  // build all the headers first, since iovecs point into them
+  std::vector<size_t> offsets; // offset of the header of each metric
+  headers.clear();
+  if (version == 1) {
+    headers.append((const char*)&id, sizeof(id));
+    for (unsigned int type = 0; type < types; type++) {
+      const unsigned int n = used[type].size();
+      offsets.push_back(headers.size());
+      if (type == METRIC_SKETCH) {
+        const unsigned int magic = SKETCH_MAGIC;
+        headers.append((const char*)&magic, sizeof(magic));
+      }
+      headers.append((const char*)&n, sizeof(n));
+      for (unsigned int i = 0; i < used[type].size(); i++) {
+        offsets.push_back(headers.size());
+        headers.append((const char*)&metrics[used[type][i]].count,
+                       sizeof(unsigned int));
+      }
+    }
+  } else {
+    Codec::putVarint(headers, id);
+    for (unsigned int type = 0; type < types; type++) {
+      offsets.push_back(headers.size());
+      Codec::putVarint(headers, used[type].size());
+      for (unsigned int i = 0; i < used[type].size(); i++) {
+        const Metric& m = metrics[used[type][i]]; // alias
+        offsets.push_back(headers.size());
+        Codec::putVarint(headers, used[type][i]);
+        Codec::putVarint(headers, m.count);
+        headers.append(m.indices);
+      }
+    }
+  }
+  offsets.push_back(headers.size());
+
+  // then collect the pieces of the run: header, samples, header, ...
+  std::vector<struct iovec> iov;
+  unsigned int              k      = 1;          // next header
+  size_t                    length = offsets[1]; // length of the run
+  iov.push_back(slice(headers, 0, offsets[1]));  // up to no. of avg metrics
+  for (unsigned int type = 0; type < types; type++) {
+    if (type > 0) {
+      // the number of distribution or sketch metrics
+      iov.push_back(slice(headers, offsets[k], offsets[k + 1] - offsets[k]));
+      length += offsets[k + 1] - offsets[k];
+      k++;
+    }
+    for (unsigned int i = 0; i < used[type].size(); i++, k++) {
+      const Metric& m = metrics[used[type][i]]; // alias
+      iov.push_back(slice(headers, offsets[k], offsets[k + 1] - offsets[k]));
+      length += offsets[k + 1] - offsets[k];
+      if (version == 1) {
+        iov.push_back(slice(m.prefix, 0, m.prefix.size()));
+        length += m.prefix.size();
+      }
+      iov.push_back(slice(m.samples, 0, m.samples.size()));
+      length += m.samples.size();
+    }
+  }
+
+  // the compact format needs the hello and the dictionary first,
+  // and the length of each run
+  std::string lead;
+  if (version != 1) {
+    if (!started) {
+      const unsigned int hello[2] = {PROTOCOL_MAGIC, PROTOCOL_VERSION};
+      lead.append((const char*)hello, sizeof(hello));
+      dictionary.write(lead);
+    }
+    Codec::putVarint(lead, length);
+    iov.insert(iov.begin(), slice(lead, 0, lead.size()));
+  }
+
+  const bool ok = write(iov);
+
+  // reset the buffers, keeping their memory for the next run
+  for (unsigned int type = 0; type < types; type++) {
+    for (unsigned int i = 0; i < used[type].size(); i++) {
+      Metric& m = metrics[used[type][i]]; // alias
+      m.count   = 0;
+      m.indices.clear();
+      m.samples.clear();
+    }
+    used[type].clear();
+  }
+  inRun   = false;
+  started = true;
+
+  if (!ok)
+    throw *this;
+}
+
+bool RunWriter::write(std::vector<struct iovec>& iov) {
+  unsigned int first = 0;
+  while (first < iov.size()) {
+    const int n   = (iov.size() - first > IOV_MAX) ? IOV_MAX
+                                                   : iov.size() - first;
+    ssize_t   ret = ::writev(fd, &iov[first], n);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    while (first < iov.size() && (size_t)ret >= iov[first].iov_len) {
+      ret -= iov[first].iov_len;
+      first++;
+    }
+    if (ret > 0) {
+      iov[first].iov_base = (char*)iov[first].iov_base + ret;
+      iov[first].iov_len -= ret;
+    }
+  }
+  return true;
+}
+
+bool RunWriter::readHandshake(int fd, std::set<unsigned int>& ids) {
+  unsigned int n;  // number of saved run identifiers
+  unsigned int id; // saved run identifier
+  if (!readAll(fd, &n, sizeof(n)))
+    throw Object("RunWriter");
+  for (unsigned int i = 0; i < n; i++) {
+    if (!readAll(fd, &id, sizeof(id)))
+      throw Object("RunWriter");
+    ids.insert(id);
+  }
+  return readCommand(fd);
+}
+
+bool RunWriter::readCommand(int fd) {
+  unsigned int command; // 1 (go) or 0 (stop)
+  if (!readAll(fd, &command, sizeof(command)))
+    throw Object("RunWriter");
+  return command == 1;
+}
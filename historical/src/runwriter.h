@@ -0,0 +1,170 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: runwriter.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           producer side of the communication protocol
+*/
+
+#ifndef __MEASURE_RUNWRITER_H
+#define __MEASURE_RUNWRITER_H
+
+#include <config.h>
+#include <object.h>
+#include <protocol.h>
+#include <sketch.h>
+
+#include <set>
+#include <string>
+#include <vector>
+
+#include <sys/uio.h>
+
+//! Emit runs in the communication protocol, on the simulator side.
+/*!
+  Metrics are registered once, and then referred to by the handle
+  returned on registration. The samples of a run are buffered per
+  metric, into buffers which are reused from one run to the next, and
+  the whole run is emitted by endRun() with a single writev, without
+  copying the samples again.
+
+  The descriptor can be a file, a FIFO or a socket. With version 1 the
+  runs are emitted as in input.h, hence they can be read by
+  Input::loadData or stored as a save file. With version 2 the hello
+  and the dictionary are emitted with the first run, then the runs are
+  emitted in the compact format (see protocol.h), which can only be
+  read by the Server.
+
+  Samples of the same metric and index must not be added twice to the
+  same run.
+
+  Sketch metrics are emitted after the distribution metrics, in an
+  optional section which is omitted in the runs without sketches. In
+  version 1, they can be read by Input::loadData and Input::loadRing,
+  but not by the Server, which needs version 2 for sketch metrics.
+  */
+class RunWriter : public Object
+{
+  //! Buffers of a registered metric.
+  struct Metric {
+    //! Part of the header of the metric that does not change (version 1).
+    std::string prefix;
+    //! Number of bins (1 for averaged metrics, 0 for sketch metrics).
+    unsigned int bins;
+    //! Number of indices in the current run.
+    unsigned int count;
+    //! Last index in the current run (version 2).
+    unsigned int last;
+    //! Indices (version 2) of the current run.
+    std::string indices;
+    //! Samples, preceded by their index in version 1, of the current run.
+    /*!
+      A sketch is stored as in input.h (version 1) or protocol.h.
+      */
+    std::string samples;
+  };
+
+  //! Output descriptor.
+  int fd;
+  //! Protocol version.
+  unsigned int version;
+  //! True if the hello and the dictionary have been emitted (version 2).
+  bool started;
+  //! True between beginRun() and endRun().
+  bool inRun;
+  //! Identifier of the current run.
+  unsigned int id;
+  //! Metric dictionary, with the same handles as metrics.
+  Dictionary dictionary;
+  //! Registered metrics.
+  std::vector<Metric> metrics;
+  //! Handles of the metrics with samples in the current run, by type.
+  std::vector<unsigned int> used[METRIC_NONE];
+  //! Headers built by endRun().
+  std::string headers;
+
+  //! Register a metric and return its handle.
+  unsigned int add(MetricType   type,
+                   std::string  name,
+                   sample_t     binSize,
+                   sample_t     distLower,
+                   unsigned int bins,
+                   sample_t     accuracy);
+  //! Add the index of a metric to the current run, and return the metric.
+  Metric& addIndex(unsigned int handle, unsigned int index);
+  //! Add the samples of a metric to the current run.
+  void add(unsigned int handle, unsigned int index, const sample_t* x);
+  //! Write all the buffers, with as few calls as possible.
+  /*!
+    Return false on error.
+    */
+  bool write(std::vector<struct iovec>& iov);
+
+ public:
+  //! Create a RunWriter on an open descriptor, which is not closed.
+  RunWriter(int fd, unsigned int version = 1);
+  //! Do nothing.
+  ~RunWriter() {
+  }
+
+  //! Register an averaged metric and return its handle.
+  unsigned int avgMetric(std::string name);
+  //! Register a distribution metric and return its handle.
+  unsigned int dstMetric(std::string  name,
+                         sample_t     binSize,
+                         sample_t     distLower,
+                         unsigned int bins);
+  //! Register a sketch metric and return its handle.
+  unsigned int sktMetric(std::string name, sample_t accuracy = SKETCH_ACCURACY);
+
+  //! Start a new run.
+  void beginRun(unsigned int id);
+  //! Add a sample of an averaged metric to the current run.
+  void avg(unsigned int handle, unsigned int index, sample_t x) {
+    add(handle, index, &x);
+  }
+  //! Add a distribution, with one sample per bin, to the current run.
+  void dist(unsigned int handle, unsigned int index, const sample_t* x) {
+    add(handle, index, x);
+  }
+  //! Add a sketch, with the accuracy of the metric, to the current run.
+  void sketch(unsigned int handle, unsigned int index, const Sketch& s);
+  //! Emit the current run. An exception is thrown on error.
+  void endRun();
+
+  //! Read the list of saved run identifiers, then go or stop.
+  /*!
+    Return true on go. An exception is thrown on premature end of file.
+    */
+  static bool readHandshake(int fd, std::set<unsigned int>& ids);
+  //! Read go or stop. Return true on go.
+  /*!
+    An exception is thrown on premature end of file.
+    */
+  static bool readCommand(int fd);
+};
+
+#endif // __MEASURE_RUNWRITER_H
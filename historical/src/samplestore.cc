@@ -0,0 +1,159 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: samplestore.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the SampleStore class
+*/
+
+#include <samplestore.h>
+
+#include <algorithm>
+#include <mutex>
+
+#include <string.h>
+
+namespace {
+
+//! Free chunks, shared by all the stores.
+/*!
+  The pool is never destroyed, so that stores can be destroyed safely
+  during the static destruction.
+  */
+struct Pool {
+  //! Protects the free chunks.
+  std::mutex mutex;
+  //! Free chunks, at most SAMPLE_POOL_SIZE.
+  std::vector<sample_t*> chunks;
+};
+
+Pool& pool() {
+  static Pool* p = new Pool;
+  return *p;
+}
+
+} // namespace
+
+sample_t* SampleStore::allocate(unsigned int size) {
+  if (size < SAMPLE_CHUNK_SIZE)
+    return new sample_t[size];
+
+  Pool&                       p = pool();
+  std::lock_guard<std::mutex> lock(p.mutex);
+  if (p.chunks.empty())
+    return new sample_t[SAMPLE_CHUNK_SIZE];
+  sample_t* chunk = p.chunks.back();
+  p.chunks.pop_back();
+  return chunk;
+}
+
+void SampleStore::release(sample_t* chunk, unsigned int size) {
+  if (size < SAMPLE_CHUNK_SIZE) {
+    delete[] chunk;
+    return;
+  }
+
+  Pool&                       p = pool();
+  std::lock_guard<std::mutex> lock(p.mutex);
+  if (p.chunks.size() < SAMPLE_POOL_SIZE)
+    p.chunks.push_back(chunk);
+  else
+    delete[] chunk;
+}
+
+SampleStore::SampleStore(const SampleStore& s)
+    : n(0)
+    , first(0) {
+  *this = s;
+}
+
+SampleStore& SampleStore::operator=(const SampleStore& s) {
+  if (this == &s)
+    return *this;
+  resize(s.n);
+  for (unsigned int k = 0; k < chunks.size(); k++) {
+    unsigned int    size = 0;
+    const sample_t* x    = s.span(k, size);
+    memcpy(chunks[k], x, size * sizeof(sample_t));
+  }
+  return *this;
+}
+
+void SampleStore::reallocate(unsigned int size) {
+  sample_t* chunk = allocate(size);
+  if (!chunks.empty()) {
+    memcpy(chunk, chunks[0], (n < size ? n : size) * sizeof(sample_t));
+    release(chunks[0], first);
+    chunks[0] = chunk;
+  } else {
+    chunks.push_back(chunk);
+  }
+  first = size;
+}
+
+void SampleStore::grow() {
+  if (first == 0)
+    reallocate(SAMPLE_FIRST_CHUNK_SIZE);
+  else if (first < SAMPLE_CHUNK_SIZE)
+    reallocate(2 * first);
+  else
+    chunks.push_back(allocate());
+}
+
+void SampleStore::resize(unsigned int size) {
+  if (size == 0) {
+    while (!chunks.empty()) {
+      release(chunks.back(), chunks.size() > 1 ? SAMPLE_CHUNK_SIZE : first);
+      chunks.pop_back();
+    }
+    n     = 0;
+    first = 0;
+    return;
+  }
+
+  // a single chunk is only as large as needed
+  const unsigned int needed = size / SAMPLE_CHUNK_SIZE +
+                              (size % SAMPLE_CHUNK_SIZE > 0 ? 1 : 0);
+  while (chunks.size() > needed) {
+    release(chunks.back());
+    chunks.pop_back();
+  }
+  unsigned int target = first > 0 ? first : SAMPLE_FIRST_CHUNK_SIZE;
+  while (target < size && target < SAMPLE_CHUNK_SIZE)
+    target *= 2;
+  if (target > first)
+    reallocate(target);
+  chunks.reserve(needed);
+  while (chunks.size() < needed)
+    chunks.push_back(allocate());
+  n = size;
+}
+
+void SampleStore::swap(SampleStore& s) {
+  chunks.swap(s.chunks);
+  std::swap(n, s.n);
+  std::swap(first, s.first);
+}
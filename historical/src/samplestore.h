@@ -0,0 +1,138 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: samplestore.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           storage of the samples of a population
+*/
+
+#ifndef __MEASURE_SAMPLESTORE_H
+#define __MEASURE_SAMPLESTORE_H
+
+#include <config.h>
+
+#include <vector>
+
+//! Samples of a population, stored in fixed-size chunks.
+/*!
+  A new chunk is added when the last one is full, hence the samples
+  are never moved while the store grows, and adding a sample takes
+  constant time regardless of the size of the store. The chunks are
+  taken from a pool shared by all the stores, and returned to it when
+  the store shrinks or it is destroyed.
+
+  Most populations only hold a few samples, e.g., one per run, hence
+  the first chunk starts with SAMPLE_FIRST_CHUNK_SIZE samples and it
+  doubles until it is full-size, moving the samples. Only full-size
+  chunks are pooled.
+
+  Each chunk is a span of contiguous samples: the statistics that need
+  all the samples should iterate over the spans rather than use
+  operator[].
+  */
+class SampleStore
+{
+  //! Chunks of SAMPLE_CHUNK_SIZE samples each, only the last may be partial.
+  /*!
+    The first chunk is smaller if it is the only one (see first).
+    */
+  std::vector<sample_t*> chunks;
+  //! Number of samples.
+  unsigned int n;
+  //! Size of the first chunk, 0 if there are no chunks.
+  unsigned int first;
+
+  //! Take a chunk of a given size, from the pool if full-size.
+  static sample_t* allocate(unsigned int size = SAMPLE_CHUNK_SIZE);
+  //! Return a chunk of a given size, to the pool if full-size.
+  static void release(sample_t* chunk, unsigned int size = SAMPLE_CHUNK_SIZE);
+  //! Replace the first chunk with one of a given size, moving the samples.
+  void reallocate(unsigned int size);
+  //! Make room for one more sample.
+  void grow();
+  //! Return the number of samples that fit in the chunks.
+  unsigned int capacity() const {
+    return chunks.size() > 1 ? chunks.size() * SAMPLE_CHUNK_SIZE : first;
+  }
+
+ public:
+  //! Create an empty store.
+  SampleStore()
+      : n(0)
+      , first(0) {
+  }
+  //! Copy the samples of another store.
+  SampleStore(const SampleStore& s);
+  //! Return the chunks to the pool.
+  ~SampleStore() {
+    resize(0);
+  }
+  //! Copy the samples of another store.
+  SampleStore& operator=(const SampleStore& s);
+
+  //! Return the number of samples.
+  unsigned int size() const {
+    return n;
+  }
+  //! Return true if there are no samples.
+  bool empty() const {
+    return n == 0;
+  }
+  //! Add a sample at the end.
+  void push_back(sample_t x) {
+    if (n == capacity())
+      grow();
+    chunks[n / SAMPLE_CHUNK_SIZE][n % SAMPLE_CHUNK_SIZE] = x;
+    n++;
+  }
+  //! Return the i-th sample, which must exist.
+  sample_t operator[](unsigned int i) const {
+    return chunks[i / SAMPLE_CHUNK_SIZE][i % SAMPLE_CHUNK_SIZE];
+  }
+  //! Change the number of samples. New samples are not initialized.
+  void resize(unsigned int size);
+  //! Exchange the samples with those of another store.
+  void swap(SampleStore& s);
+
+  //! Return the number of spans of contiguous samples.
+  unsigned int spans() const {
+    return chunks.size();
+  }
+  //! Return the k-th span and its number of samples in size.
+  const sample_t* span(unsigned int k, unsigned int& size) const {
+    size = (k + 1 < chunks.size()) ? SAMPLE_CHUNK_SIZE
+                                   : n - k * SAMPLE_CHUNK_SIZE;
+    return chunks[k];
+  }
+  //! Return the k-th span and its number of samples, for writing.
+  sample_t* span(unsigned int k, unsigned int& size) {
+    size = (k + 1 < chunks.size()) ? SAMPLE_CHUNK_SIZE
+                                   : n - k * SAMPLE_CHUNK_SIZE;
+    return chunks[k];
+  }
+};
+
+#endif // __MEASURE_SAMPLESTORE_H
@@ -0,0 +1,186 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: savewriter.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the SaveWriter class
+*/
+
+#include <savewriter.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <vector>
+
+SaveWriter::SaveWriter(std::string  fileName,
+                       SyncPolicy   p,
+                       unsigned int n,
+                       unsigned int q)
+    : Object("SaveWriter")
+    , fd(-1)
+    , policy(p)
+    , every(n > 0 ? n : 1)
+    , queueSize(q > 0 ? q : 1)
+    , appended(0)
+    , written(0)
+    , stopping(false)
+    , failed(false) {
+  fd = ::open(fileName.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+  if (fd < 0)
+    throw Object(*this);
+  thread = std::thread(&SaveWriter::run, this);
+}
+
+SaveWriter::~SaveWriter() {
+  try {
+    close();
+  } catch (const Object&) {
+    // errors are ignored in the destructor
+  }
+}
+
+bool SaveWriter::writeBatch(const std::deque<std::string>& batch) {
+  std::vector<struct iovec> iov;
+  for (unsigned int i = 0; i < batch.size(); i++) {
+    if (batch[i].empty())
+      continue;
+    struct iovec v;
+    v.iov_base = (void*)batch[i].data();
+    v.iov_len  = batch[i].size();
+    iov.push_back(v);
+  }
+
+  // write everything, possibly with more than one call in case of
+  // partial writes or more than IOV_MAX runs
+  unsigned int first = 0;
+  while (first < iov.size()) {
+    const int n   = (iov.size() - first > IOV_MAX) ? IOV_MAX
+                                                   : iov.size() - first;
+    ssize_t   ret = ::writev(fd, &iov[first], n);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      return false;
+    }
+    while (first < iov.size() && (size_t)ret >= iov[first].iov_len) {
+      ret -= iov[first].iov_len;
+      first++;
+    }
+    if (ret > 0) {
+      iov[first].iov_base = (char*)iov[first].iov_base + ret;
+      iov[first].iov_len -= ret;
+    }
+  }
+  return true;
+}
+
+void SaveWriter::run() {
+  std::unique_lock<std::mutex> lock(mutex);
+  std::deque<std::string>      batch;
+  unsigned int                 unsynced = 0; // runs written, not synced
+
+  for (;;) {
+    while (queue.empty() && !stopping)
+      notEmpty.wait(lock);
+    if (queue.empty())
+      break; // stopping, and nothing left to write
+
+    // take all the pending runs and write them without holding the lock
+    batch.swap(queue);
+    notFull.notify_all();
+    lock.unlock();
+
+    bool ok = writeBatch(batch);
+    unsynced += batch.size();
+    if (ok && (policy == SYNC_RUN ||
+               (policy == SYNC_EVERY && unsynced >= every))) {
+      ok       = ::fsync(fd) == 0;
+      unsynced = 0;
+    }
+
+    lock.lock();
+    written += batch.size();
+    batch.clear();
+    if (!ok)
+      failed = true;
+    done.notify_all();
+  }
+
+  // synchronize on stop, whatever the policy
+  if (unsynced > 0 && ::fsync(fd) != 0)
+    failed = true;
+  done.notify_all();
+}
+
+void SaveWriter::append(std::string& run) {
+  std::unique_lock<std::mutex> lock(mutex);
+
+  while (queue.size() >= queueSize && !failed && !stopping)
+    notFull.wait(lock);
+  if (failed || stopping)
+    throw Object(*this);
+
+  queue.push_back(std::string());
+  queue.back().swap(run);
+  const unsigned long long ticket = ++appended;
+  notEmpty.notify_one();
+
+  // with SYNC_RUN wait until this run is on disk
+  if (policy == SYNC_RUN) {
+    while (written < ticket && !failed)
+      done.wait(lock);
+    if (failed)
+      throw Object(*this);
+  }
+}
+
+void SaveWriter::flush() {
+  std::unique_lock<std::mutex> lock(mutex);
+  while (written < appended && !failed)
+    done.wait(lock);
+  if (failed)
+    throw Object(*this);
+}
+
+void SaveWriter::close() {
+  {
+    std::unique_lock<std::mutex> lock(mutex);
+    if (fd < 0)
+      return;
+    stopping = true;
+    notEmpty.notify_one();
+  }
+  thread.join();
+
+  const bool ok = ::close(fd) == 0 && !failed;
+  fd            = -1;
+  if (!ok)
+    throw Object(*this);
+}
@@ -0,0 +1,117 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: savewriter.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           write-behind appender of runs to the save file
+*/
+
+#ifndef __MEASURE_SAVEWRITER_H
+#define __MEASURE_SAVEWRITER_H
+
+#include <config.h>
+#include <object.h>
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+
+//! When the save file is synchronized to disk (fsync).
+enum SyncPolicy {
+  SYNC_RUN,   //!< after each run, before append() returns
+  SYNC_EVERY, //!< after every N runs, in the background
+  SYNC_STOP   //!< only when the save file is closed
+};
+
+//! Append runs to the save file from a background thread.
+/*!
+  Each run is appended with a single write, possibly together with the
+  other runs pending in the queue. The queue is bounded: append() blocks
+  if the queue is full. With the SYNC_RUN policy, append() also waits
+  until the run has been written and synchronized to disk, so that the
+  durability is the same as with a synchronous write.
+
+  If a write fails, the next call to append() or close() throws. Since
+  this class is not copyable, a plain Object is thrown.
+  */
+class SaveWriter : public Object
+{
+  //! Save file descriptor.
+  int fd;
+  //! Synchronization policy.
+  SyncPolicy policy;
+  //! Number of runs between two synchronizations, with SYNC_EVERY.
+  unsigned int every;
+  //! Maximum number of runs in the queue.
+  unsigned int queueSize;
+
+  //! Runs to be written.
+  std::deque<std::string> queue;
+  //! Number of runs appended so far.
+  unsigned long long appended;
+  //! Number of runs written (and synchronized, with SYNC_RUN) so far.
+  unsigned long long written;
+  //! True if the background thread must terminate.
+  bool stopping;
+  //! True if a write or synchronization failed.
+  bool failed;
+
+  //! Protect all the above variables.
+  std::mutex mutex;
+  //! Signaled when a run is added to the queue, or on stop.
+  std::condition_variable notEmpty;
+  //! Signaled when runs are removed from the queue.
+  std::condition_variable notFull;
+  //! Signaled when runs have been written.
+  std::condition_variable done;
+  //! Background thread.
+  std::thread thread;
+
+  //! Body of the background thread.
+  void run();
+  //! Write a batch of runs at once. Return false on error.
+  bool writeBatch(const std::deque<std::string>& batch);
+
+ public:
+  //! Open the save file for appending and start the background thread.
+  SaveWriter(std::string  fileName,
+             SyncPolicy   policy    = SYNC_STOP,
+             unsigned int every     = 1,
+             unsigned int queueSize = SAVE_QUEUE_SIZE);
+  //! Close the save file, if not already done. Errors are ignored.
+  ~SaveWriter();
+
+  //! Append a run. The content of run is moved into the queue.
+  void append(std::string& run);
+  //! Wait until all the runs appended so far have been written.
+  void flush();
+  //! Write all the pending runs, synchronize and close the save file.
+  void close();
+};
+
+#endif // __MEASURE_SAVEWRITER_H
@@ -0,0 +1,353 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: server.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the Server class
+*/
+
+#include <server.h>
+#include <string.h>
+
+#include <errno.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <sstream>
+
+Server::~Server() {
+  while (!clients.empty())
+    drop(clients.begin()->first);
+  if (listenFd >= 0)
+    ::close(listenFd);
+  if (epollFd >= 0)
+    ::close(epollFd);
+}
+
+size_t Server::runLength(const char* buf, size_t size) {
+  size_t       pos = 0; // current position in buf
+  unsigned int avg;     // number of averaged metrics
+  unsigned int dst;     // number of distribution metrics
+  unsigned int ndx;     // number of indices
+  unsigned int len;     // length of the strings (including trailing '\0')
+  unsigned int bin;     // number of bins of distribution metrics
+
+  // skip the run identifier and read the number of averaged metrics
+  if (size < pos + 2 * sizeof(unsigned int))
+    return 0;
+  memcpy(&avg, buf + pos + sizeof(unsigned int), sizeof(avg));
+  pos += 2 * sizeof(unsigned int);
+
+  for (unsigned int i = 0; i < avg; i++) {
+    if (size < pos + 2 * sizeof(unsigned int))
+      return 0;
+    memcpy(&ndx, buf + pos, sizeof(ndx));
+    memcpy(&len, buf + pos + sizeof(ndx), sizeof(len));
+    if (len > MAX_METRIC_NAME)
+      throw Object("Server");
+    pos += 2 * sizeof(unsigned int) + len +
+           (size_t)ndx * (sizeof(unsigned int) + sizeof(sample_t));
+    if (size < pos)
+      return 0;
+  }
+
+  if (size < pos + sizeof(dst))
+    return 0;
+  memcpy(&dst, buf + pos, sizeof(dst));
+  pos += sizeof(dst);
+
+  for (unsigned int i = 0; i < dst; i++) {
+    if (size < pos + 2 * sizeof(unsigned int))
+      return 0;
+    memcpy(&ndx, buf + pos, sizeof(ndx));
+    memcpy(&len, buf + pos + sizeof(ndx), sizeof(len));
+    if (len > MAX_METRIC_NAME)
+      throw Object("Server");
+    pos += 2 * sizeof(unsigned int) + len + 2 * sizeof(sample_t);
+    if (size < pos + sizeof(bin))
+      return 0;
+    memcpy(&bin, buf + pos, sizeof(bin));
+    pos += sizeof(bin);
+    // ndx * step may not fit into size_t if the run is bogus
+    const size_t step = sizeof(unsigned int) + (size_t)bin * sizeof(sample_t);
+    if (ndx > (size - pos) / step)
+      return 0;
+    pos += ndx * step;
+  }
+
+  // the end of a run cannot be told apart from the optional section of the
+  // sketch metrics, hence version 1 clients must not send them
+  unsigned int magic;
+  if (size >= pos + sizeof(magic)) {
+    memcpy(&magic, buf + pos, sizeof(magic));
+    if (magic == SKETCH_MAGIC)
+      throw Object("Server");
+  }
+  return pos;
+}
+
+void Server::accept() {
+  for (;;) {
+    const int fd = ::accept4(listenFd, NULL, NULL, SOCK_NONBLOCK);
+    if (fd < 0) {
+      if (errno == EINTR || errno == ECONNABORTED)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        return;
+      throw *this;
+    }
+
+    struct epoll_event ev;
+    ev.events  = EPOLLIN;
+    ev.data.fd = fd;
+    if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &ev) < 0) {
+      ::close(fd);
+      throw *this;
+    }
+    Client& c = clients[fd];
+
+    // send the list of run identifiers received so far, then go
+    const std::set<unsigned int>& ids = input.getRunIdentifiers(); // alias
+    unsigned int command = ids.size();
+    c.out.append((const char*)&command, sizeof(command));
+    std::set<unsigned int>::const_iterator it;
+    for (it = ids.begin(); it != ids.end(); it++) {
+      command = *it;
+      c.out.append((const char*)&command, sizeof(command));
+    }
+    command = 1; // go
+    c.out.append((const char*)&command, sizeof(command));
+    if (!send(fd, c))
+      drop(fd);
+  }
+}
+
+bool Server::send(int fd, Client& c) {
+  size_t sent = 0;
+  while (sent < c.out.size()) {
+    const ssize_t ret = ::send(
+        fd, c.out.data() + sent, c.out.size() - sent, MSG_NOSIGNAL);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      return false;
+    }
+    sent += ret;
+  }
+  c.out.erase(0, sent);
+
+  // wait for the socket to become writable only if there is data left
+  struct epoll_event ev;
+  ev.events  = c.out.empty() ? EPOLLIN : EPOLLIN | EPOLLOUT;
+  ev.data.fd = fd;
+  return ::epoll_ctl(epollFd, EPOLL_CTL_MOD, fd, &ev) == 0;
+}
+
+bool Server::receive(int fd, Client& c, SaveWriter& writer, bool& done) {
+  char buf[COPY_BUFFER_SIZE];
+  bool closed = false;
+  for (;;) {
+    const ssize_t ret = ::recv(fd, buf, sizeof(buf), 0);
+    if (ret < 0) {
+      if (errno == EINTR)
+        continue;
+      if (errno == EAGAIN || errno == EWOULDBLOCK)
+        break;
+      return false;
+    }
+    if (ret == 0) {
+      closed = true;
+      break;
+    }
+    c.in.append(buf, ret);
+  }
+
+  // read all the complete messages received so far
+  size_t      consumed = 0;
+  std::string run; // bytes of the last run read
+  for (;;) {
+    const char*  p      = c.in.data() + consumed; // next message
+    const size_t left   = c.in.size() - consumed; // bytes available
+    size_t       n      = 0;                      // length of the message
+    size_t       header = 0; // length of the length field, if any
+
+    // the first bytes select the protocol version
+    if (c.version == 0) {
+      unsigned int hello[2]; // magic number and version
+      if (left < sizeof(hello[0]))
+        break;
+      memcpy(hello, p, sizeof(hello[0]));
+      if (hello[0] != PROTOCOL_MAGIC) {
+        c.version = 1;
+        continue;
+      }
+      if (left < sizeof(hello))
+        break;
+      memcpy(hello, p, sizeof(hello));
+      if (hello[1] != PROTOCOL_VERSION)
+        return false;
+      c.version = hello[1];
+      consumed += sizeof(hello);
+      continue;
+    }
+
+    // drop clients sending bogus data
+    try {
+      if (c.version == 1)
+        n = runLength(p, left);
+      else
+        n = Dictionary::messageLength(p, left, header);
+      if (n == 0)
+        break;
+      consumed += n;
+
+      if (c.version == 1) {
+        std::istringstream is(std::string(p, n));
+        input.readSingleRun(is, &run);
+      } else if (c.hasDictionary) {
+        input.readCompactRun(p + header, n - header, c.dictionary, &run);
+      } else {
+        c.dictionary.read(p + header, n - header);
+        c.hasDictionary = true;
+        continue; // the dictionary is not replied
+      }
+    } catch (const Object&) {
+      return false;
+    }
+
+    input.append(writer, run);
+    if (input.check() == true) {
+      done = true;
+      return true;
+    }
+    const unsigned int command = 1; // go
+    c.out.append((const char*)&command, sizeof(command));
+  }
+  c.in.erase(0, consumed);
+
+  return !closed && send(fd, c);
+}
+
+void Server::drop(int fd) {
+  ::epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, NULL);
+  ::close(fd);
+  clients.erase(fd);
+}
+
+void Server::stopAll() {
+  while (!clients.empty()) {
+    const int fd = clients.begin()->first;
+    Client&   c  = clients.begin()->second; // alias
+
+    // best effort: the reply is lost if the socket buffer is full,
+    // which only happens if the client is not reading anyway
+    const unsigned int command = 0; // stop
+    c.out.append((const char*)&command, sizeof(command));
+    send(fd, c);
+    drop(fd);
+  }
+}
+
+void Server::run(std::string socketName) {
+  // load data from the save file, if any, as in Input::loadData
+  input.loadSaveFile();
+
+  // if the saved data fulfills the confidence requirements, exit immediately
+  if (input.check() == true)
+    return;
+
+  // create the listening socket
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (socketName.size() >= sizeof(addr.sun_path))
+    throw *this;
+  strcpy(addr.sun_path, socketName.c_str());
+  ::unlink(socketName.c_str());
+  listenFd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0);
+  if (listenFd < 0 ||
+      ::bind(listenFd, (struct sockaddr*)&addr, sizeof(addr)) < 0 ||
+      ::listen(listenFd, SOMAXCONN) < 0)
+    throw *this;
+
+  epollFd = ::epoll_create1(0);
+  if (epollFd < 0)
+    throw *this;
+  struct epoll_event ev;
+  ev.events  = EPOLLIN;
+  ev.data.fd = listenFd;
+  if (::epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &ev) < 0)
+    throw *this;
+
+  // open the save file, where runs are appended in the background
+  SaveWriter writer(configuration.getOutputFileName(),
+                    configuration.getSyncPolicy(),
+                    configuration.getSyncEvery());
+
+  struct epoll_event events[SERVER_MAX_EVENTS];
+  bool               done = false;
+  while (!done) {
+    const int n = ::epoll_wait(epollFd, events, SERVER_MAX_EVENTS, -1);
+    if (n < 0) {
+      if (errno == EINTR)
+        continue;
+      throw *this;
+    }
+    for (int i = 0; i < n && !done; i++) {
+      const int fd = events[i].data.fd;
+      if (fd == listenFd) {
+        accept();
+        continue;
+      }
+
+      // the client may have been dropped while handling previous events
+      std::map<int, Client>::iterator it = clients.find(fd);
+      if (it == clients.end())
+        continue;
+
+      bool ok = true;
+      if (events[i].events & EPOLLOUT)
+        ok = send(fd, it->second);
+      if (ok && (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)))
+        ok = receive(fd, it->second, writer, done);
+      if (!ok)
+        drop(fd);
+    }
+  }
+
+  stopAll();
+  ::close(listenFd);
+  ::close(epollFd);
+  listenFd = -1;
+  epollFd  = -1;
+  ::unlink(socketName.c_str());
+  writer.close();
+  input.writeSnapshot();
+}
@@ -0,0 +1,168 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: server.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           server collecting runs from many concurrent clients
+*/
+
+/*
+        communication protocol over the Unix domain socket
+
+        Each connection follows the same protocol as Input::loadData,
+        with the connected socket in place of both the input and the
+        output files:
+
+        server -> client:
+          UIN   number of saved run identifiers = n
+          UIN   run identifier i (i=0,1,..,n-1)             -| n times
+          UIN   1 (go) or 0 (stop)
+
+        then, until the server replies stop:
+
+        client -> server:
+          a run, as in the protocol of input.h, without checksum trailer
+        server -> client:
+          UIN   1 (go) or 0 (stop)
+
+        Alternatively, the client can send the hello and the dictionary
+        of the compact protocol (see protocol.h), to which the server
+        does not reply, then the runs in the compact format. Therefore,
+        PROTOCOL_MAGIC cannot be used as the identifier of the first run
+        sent by a client using the protocol of input.h. Sketch metrics
+        can only be sent with the compact protocol: since the end of a
+        run cannot be told apart from the optional section of the sketch
+        metrics, clients using the protocol of input.h are dropped if
+        the section is found.
+
+        The list of run identifiers only includes the runs received
+        before the client connected. A run whose identifier has already
+        been received from another client is replied go, but ignored.
+        When the confidence requirements are met, stop is sent to all
+        the connected clients, irrespective of whether they are in the
+        middle of a run, and the server returns.
+*/
+
+#ifndef __MEASURE_SERVER_H
+#define __MEASURE_SERVER_H
+
+#include <configuration.h>
+#include <input.h>
+#include <object.h>
+#include <protocol.h>
+#include <savewriter.h>
+
+#include <map>
+#include <string>
+
+//! Collect runs from many clients connected to a Unix domain socket.
+/*!
+  Clients are multiplexed with epoll in a single thread. The bytes
+  received from each client are buffered until a complete run is found,
+  which is then read by the Input object and appended to the save file.
+  */
+class Server : public Object
+{
+  //! State of a connected client.
+  struct Client {
+    //! Protocol version, 0 until the first bytes are received.
+    unsigned int version;
+    //! True if the dictionary has been received (compact protocol only).
+    bool hasDictionary;
+    //! Metric dictionary (compact protocol only).
+    Dictionary dictionary;
+    //! Bytes received, not yet consumed.
+    std::string in;
+    //! Bytes to be sent.
+    std::string out;
+
+    //! Create the state of a new client.
+    Client()
+        : version(0)
+        , hasDictionary(false) {
+    }
+  };
+
+  //! Configuration object.
+  Configuration& configuration;
+  //! Input object used to read runs.
+  Input& input;
+  //! Listening socket.
+  int listenFd;
+  //! Epoll descriptor.
+  int epollFd;
+  //! Connected clients, indexed by socket descriptor.
+  std::map<int, Client> clients;
+
+  //! Return the length of the run at the beginning of buf.
+  /*!
+    Only the headers of the metrics are read. Return 0 if the run is not
+    complete in the first size bytes of buf. An exception is thrown if
+    buf does not begin with a valid run: not a copy of this object,
+    whose destructor would close the sockets.
+    */
+  static size_t runLength(const char* buf, size_t size);
+  //! Accept all the pending connections.
+  void accept();
+  //! Send as much as possible of the pending data of a client.
+  /*!
+    Return false if the connection must be closed.
+    */
+  bool send(int fd, Client& c);
+  //! Receive data from a client, and read all the complete runs.
+  /*!
+    The runs are appended to the save file through writer. Return false
+    if the connection must be closed. Set done to true if no more runs
+    are needed.
+    */
+  bool receive(int fd, Client& c, SaveWriter& writer, bool& done);
+  //! Remove a client and close its connection.
+  void drop(int fd);
+  //! Send stop to all the clients and close all the connections.
+  void stopAll();
+
+ public:
+  //! Create a server. The socket is created by run().
+  Server(Configuration& c, Input& i)
+      : Object("Server")
+      , configuration(c)
+      , input(i)
+      , listenFd(-1)
+      , epollFd(-1) {
+  }
+  //! Close all the descriptors, if still open.
+  ~Server();
+
+  //! Collect runs from clients connected to a Unix domain socket.
+  /*!
+    The saved data are loaded first, as in Input::loadData. Then, new
+    runs are appended to the save file, until check() returns true.
+    Any file with the same name as the socket is removed.
+    */
+  void run(std::string socketName);
+};
+
+#endif // __MEASURE_SERVER_H
@@ -0,0 +1,52 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: shardedmetrics.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the ShardedMetrics class
+*/
+
+#include <shardedmetrics.h>
+
+Metrics& ShardedMetrics::getShard() {
+  std::lock_guard<std::mutex> lock(mutex);
+  const std::thread::id       self = std::this_thread::get_id();
+
+  std::map<std::thread::id, Metrics>::iterator it = shards.find(self);
+  if (it != shards.end())
+    return it->second;
+  Metrics& shard = shards[self];
+  shard.copySettings(metrics);
+  return shard;
+}
+
+void ShardedMetrics::merge() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  std::map<std::thread::id, Metrics>::iterator it;
+  for (it = shards.begin(); it != shards.end(); ++it)
+    metrics.merge(it->second);
+}
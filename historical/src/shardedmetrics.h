@@ -0,0 +1,91 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: shardedmetrics.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           header of the ShardedMetrics class
+*/
+
+#ifndef __MEASURE_SHARDEDMETRICS_H
+#define __MEASURE_SHARDEDMETRICS_H
+
+#include <measure.h>
+
+#include <map>
+#include <mutex>
+#include <thread>
+
+//! Metrics filled by several threads at the same time.
+/*!
+  Each thread adds its runs to a shard of its own, i.e., a Metrics
+  object that no other thread touches, hence no locking is needed
+  while samples are added, and the running statistics, e.g., those of
+  the distributions, are never shared between threads. The shards
+  are created with the settings of the target Metrics object (see
+  Metrics::copySettings()).
+
+  The shards are merged into the target on demand, e.g., before the
+  confidence check or a snapshot: the runs of each shard are added
+  after those already there, as if they had been added by a single
+  thread, and the shards are left empty. Merging must not overlap
+  with adding samples to the shards, and each thread must finish its
+  run before a merge, since the runs of the distribution measures are
+  made of consecutive samples.
+  */
+class ShardedMetrics : public Object
+{
+  //! Metrics object into which the shards are merged.
+  Metrics& metrics;
+  //! Shard of each thread. Map elements are never moved.
+  std::map<std::thread::id, Metrics> shards;
+  //! Protect the map of the shards, not their content.
+  std::mutex mutex;
+
+ public:
+  //! Create an object without shards, to be merged into m.
+  ShardedMetrics(Metrics& m)
+      : Object("ShardedMetrics")
+      , metrics(m) {
+  }
+  //! Do nothing. The runs not merged are lost.
+  ~ShardedMetrics() {
+  }
+
+  //! Return the shard of the calling thread, which is created if needed.
+  /*!
+    The reference can be kept by the thread, which is cheaper than
+    calling this function for each sample.
+    */
+  Metrics& getShard();
+  //! Move the runs of all the shards into the target Metrics object.
+  void merge();
+  //! Return the target Metrics object.
+  Metrics& getMetrics() {
+    return metrics;
+  }
+};
+
+#endif // __MEASURE_SHARDEDMETRICS_H
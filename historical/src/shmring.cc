@@ -0,0 +1,292 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: shmring.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the ShmRing class
+*/
+
+#include <shmring.h>
+#include <string.h>
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/futex.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <new>
+
+//! Size of the header of each record, in bytes.
+#define RECORD_HEADER 8
+
+namespace {
+
+//! Wait until *word != value, or a wake-up.
+void futexWait(std::atomic<uint32_t>& word, uint32_t value) {
+  ::syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAIT, value, NULL, NULL, 0);
+}
+
+//! Wake up the process waiting on word, if any.
+void futexWake(std::atomic<uint32_t>& word) {
+  ::syscall(SYS_futex, (uint32_t*)&word, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+//! Round n up to a multiple of the record alignment.
+uint64_t align(uint64_t n) {
+  return (n + RECORD_HEADER - 1) & ~(uint64_t)(RECORD_HEADER - 1);
+}
+
+} // namespace
+
+ShmRing::ShmRing(std::string n, bool create, size_t size)
+    : Object("ShmRing")
+    , name(n)
+    , owner(create)
+    , header(NULL)
+    , data(NULL)
+    , mapped(0)
+    , position(0)
+    , other(0)
+    , last(0) {
+  int fd;
+  if (create) {
+    uint64_t s = RECORD_HEADER;
+    while (s < size)
+      s <<= 1;
+    ::shm_unlink(name.c_str());
+    fd = ::shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+    if (fd < 0)
+      throw *this;
+    mapped = sizeof(ShmRingHeader) + s;
+    if (::ftruncate(fd, mapped) < 0) {
+      ::close(fd);
+      ::shm_unlink(name.c_str());
+      throw *this;
+    }
+  } else {
+    fd = ::shm_open(name.c_str(), O_RDWR, 0);
+    struct stat st;
+    if (fd < 0)
+      throw *this;
+    if (::fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(ShmRingHeader)) {
+      ::close(fd);
+      throw *this;
+    }
+    mapped = st.st_size;
+  }
+
+  void* p = ::mmap(NULL, mapped, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  ::close(fd);
+  if (p == MAP_FAILED) {
+    if (create)
+      ::shm_unlink(name.c_str());
+    throw *this;
+  }
+  header = (ShmRingHeader*)p;
+  data   = (char*)p + sizeof(ShmRingHeader);
+
+  if (create) {
+    // the segment is zero-filled: only the atomics need to be constructed
+    new (&header->closed) std::atomic<uint32_t>(0);
+    new (&header->stopped) std::atomic<uint32_t>(0);
+    new (&header->head) std::atomic<uint64_t>(0);
+    new (&header->dataSeq) std::atomic<uint32_t>(0);
+    new (&header->consumerWaiting) std::atomic<uint32_t>(0);
+    new (&header->tail) std::atomic<uint64_t>(0);
+    new (&header->spaceSeq) std::atomic<uint32_t>(0);
+    new (&header->producerWaiting) std::atomic<uint32_t>(0);
+    header->size = mapped - sizeof(ShmRingHeader);
+    // the magic string is written last, as it marks the ring as ready
+    std::atomic_thread_fence(std::memory_order_release);
+    memcpy(header->magic, SHM_RING_MAGIC, sizeof(header->magic));
+  } else {
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (memcmp(header->magic, SHM_RING_MAGIC, sizeof(header->magic)) != 0 ||
+        header->size != mapped - sizeof(ShmRingHeader)) {
+      ::munmap(header, mapped);
+      throw *this;
+    }
+    position = header->head.load();
+    other    = header->tail.load();
+  }
+}
+
+ShmRing::~ShmRing() {
+  ::munmap(header, mapped);
+  if (owner)
+    ::shm_unlink(name.c_str());
+}
+
+bool ShmRing::waitSpace(uint64_t n) {
+  const uint64_t size = header->size;
+  while (size - (position - other) < n) {
+    other = header->tail.load(std::memory_order_acquire);
+    if (size - (position - other) >= n)
+      break;
+    if (isStopped())
+      return false;
+
+    // sleep, unless the consumer has released space in the meanwhile
+    const uint32_t seq = header->spaceSeq.load();
+    header->producerWaiting.store(1);
+    if (header->tail.load() == other && !isStopped())
+      futexWait(header->spaceSeq, seq);
+    header->producerWaiting.store(0);
+  }
+  return true;
+}
+
+char* ShmRing::reserve(size_t n) {
+  const uint64_t size   = header->size;
+  const uint64_t record = align(RECORD_HEADER + n);
+  if (record > size)
+    throw *this;
+
+  // if the record does not fit before the end of the data area,
+  // pad up to the end and start again from the beginning
+  const uint64_t offset = position & (size - 1);
+  if (offset + record > size) {
+    if (!waitSpace(size - offset))
+      return NULL;
+    *(uint32_t*)(data + offset) = SHM_RING_PAD;
+    position += size - offset;
+    if (!waitSpace(record))
+      return NULL;
+    last = record;
+    return data + RECORD_HEADER;
+  }
+
+  if (!waitSpace(record))
+    return NULL;
+  last = record;
+  return data + offset + RECORD_HEADER;
+}
+
+void ShmRing::commit(size_t n) {
+  const uint64_t offset      = position & (header->size - 1);
+  *(uint32_t*)(data + offset) = n;
+  position += last;
+
+  // publish the record, and wake up the consumer if it may be waiting
+  header->head.store(position);
+  header->dataSeq.fetch_add(1);
+  if (header->consumerWaiting.load() != 0)
+    futexWake(header->dataSeq);
+}
+
+bool ShmRing::write(const void* buf, size_t n) {
+  char* p = reserve(n);
+  if (p == NULL)
+    return false;
+  memcpy(p, buf, n);
+  commit(n);
+  return true;
+}
+
+void ShmRing::close() {
+  header->closed.store(1);
+  header->dataSeq.fetch_add(1);
+  futexWake(header->dataSeq);
+}
+
+const char* ShmRing::read(size_t& n) {
+  const uint64_t size = header->size;
+  for (;;) {
+    if (position == other) {
+      other = header->head.load(std::memory_order_acquire);
+      if (position == other) {
+        // no records: return if the producer has closed the ring
+        if (header->closed.load() != 0) {
+          other = header->head.load();
+          if (position == other)
+            return NULL;
+          continue;
+        }
+
+        // sleep, unless the producer has written a record in the meanwhile
+        const uint32_t seq = header->dataSeq.load();
+        header->consumerWaiting.store(1);
+        if (header->head.load() == position && header->closed.load() == 0)
+          futexWait(header->dataSeq, seq);
+        header->consumerWaiting.store(0);
+        continue;
+      }
+    }
+
+    const uint64_t offset = position & (size - 1);
+    const uint32_t len    = *(const uint32_t*)(data + offset);
+    if (len == SHM_RING_PAD) {
+      position += size - offset;
+      continue;
+    }
+    n    = len;
+    last = align(RECORD_HEADER + len);
+    return data + offset + RECORD_HEADER;
+  }
+}
+
+void ShmRing::release() {
+  position += last;
+  last = 0;
+
+  // publish the free space, and wake up the producer if it may be waiting
+  header->tail.store(position);
+  header->spaceSeq.fetch_add(1);
+  if (header->producerWaiting.load() != 0)
+    futexWake(header->spaceSeq);
+}
+
+void ShmRing::stop() {
+  header->stopped.store(1);
+  header->spaceSeq.fetch_add(1);
+  futexWake(header->spaceSeq);
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekoff(
+    off_type                off,
+    std::ios_base::seekdir  dir,
+    std::ios_base::openmode which) {
+  char* p;
+  if (dir == std::ios_base::beg)
+    p = eback() + off;
+  else if (dir == std::ios_base::cur)
+    p = gptr() + off;
+  else
+    p = egptr() + off;
+  if ((which & std::ios_base::in) == 0 || p < eback() || p > egptr())
+    return pos_type(off_type(-1));
+  setg(eback(), p, egptr());
+  return pos_type(p - eback());
+}
+
+MemoryStreamBuf::pos_type MemoryStreamBuf::seekpos(
+    pos_type                pos,
+    std::ios_base::openmode which) {
+  return seekoff(off_type(pos), std::ios_base::beg, which);
+}
@@ -0,0 +1,185 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: shmring.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           single-producer single-consumer ring in shared memory
+*/
+
+/*
+        layout of the shared memory segment
+
+        ShmRingHeader, then the data area, whose size is a power of two.
+        The data area holds a sequence of records, each aligned to
+        8 bytes:
+
+        type  data
+        UIN   length of the record = n, or SHM_RING_PAD
+        UIN   unused
+        CHR   record, of length n (a run, as in the protocol of input.h)
+
+        A record never wraps around the end of the data area: if there
+        is not enough room left, the producer fills the rest of the data
+        area with a SHM_RING_PAD record, which is skipped by the consumer.
+*/
+
+#ifndef __MEASURE_SHMRING_H
+#define __MEASURE_SHMRING_H
+
+#include <config.h>
+#include <object.h>
+
+#include <atomic>
+#include <cstddef>
+#include <stdint.h>
+#include <streambuf>
+#include <string>
+
+//! Header of the shared memory segment of a ShmRing.
+/*!
+  The variables written by the producer and by the consumer lie on
+  different cache lines. The sequence numbers are the futex words:
+  they are incremented whenever new data or space become available.
+  */
+struct ShmRingHeader {
+  //! Magic string, SHM_RING_MAGIC.
+  char magic[8];
+  //! Size of the data area, in bytes.
+  uint64_t size;
+  //! Set by the producer when no more records will be written.
+  std::atomic<uint32_t> closed;
+  //! Set by the consumer when no more records are needed.
+  std::atomic<uint32_t> stopped;
+
+  //! Number of bytes written so far by the producer.
+  alignas(64) std::atomic<uint64_t> head;
+  //! Incremented by the producer after each record.
+  std::atomic<uint32_t> dataSeq;
+  //! Non-zero if the consumer may be waiting on dataSeq.
+  std::atomic<uint32_t> consumerWaiting;
+
+  //! Number of bytes consumed so far by the consumer.
+  alignas(64) std::atomic<uint64_t> tail;
+  //! Incremented by the consumer after each record.
+  std::atomic<uint32_t> spaceSeq;
+  //! Non-zero if the producer may be waiting on spaceSeq.
+  std::atomic<uint32_t> producerWaiting;
+};
+
+//! Single-producer single-consumer ring of records in shared memory.
+/*!
+  The ring is a POSIX shared memory object (in /dev/shm on Linux),
+  created by the consumer and opened by the producer. The producer
+  writes a record in place with reserve() and commit(), and the consumer
+  reads it in place with read() and release(), so that a record is
+  copied only once. No locks are used: a process only sleeps, on a
+  futex, when the ring is full (producer) or empty (consumer), and the
+  other process only issues a system call to wake it up in that case.
+  */
+class ShmRing : public Object
+{
+  //! Name of the shared memory object.
+  std::string name;
+  //! True if the shared memory object has been created by this object.
+  bool owner;
+  //! Header of the mapped segment.
+  ShmRingHeader* header;
+  //! Data area of the mapped segment.
+  char* data;
+  //! Size of the mapped segment, in bytes.
+  size_t mapped;
+
+  //! Local copy of the head (producer) or of the tail (consumer).
+  uint64_t position;
+  //! Last value read of the tail (producer) or of the head (consumer).
+  uint64_t other;
+  //! Size of the last record reserved or read, including padding.
+  uint64_t last;
+
+  //! Wait until at least n bytes are free. Return false if stopped.
+  bool waitSpace(uint64_t n);
+
+ public:
+  //! Create (consumer) or open (producer) a ring.
+  /*!
+    The size of a new ring is rounded up to a power of two. An existing
+    object with the same name is replaced. An exception is thrown if
+    the object cannot be created, opened or mapped.
+    */
+  ShmRing(std::string name, bool create, size_t size = SHM_RING_SIZE);
+  //! Unmap the ring. Remove the shared memory object if created.
+  ~ShmRing();
+
+  //! Producer: get a pointer to n bytes where a record can be written.
+  /*!
+    Block if there is not enough free space. Return NULL if the
+    consumer has stopped. An exception is thrown if the record would
+    not fit into an empty ring.
+    */
+  char* reserve(size_t n);
+  //! Producer: make the n bytes written after reserve() available.
+  void commit(size_t n);
+  //! Producer: copy a record into the ring. Return false if stopped.
+  bool write(const void* buf, size_t n);
+  //! Producer: notify the consumer that no more records will be written.
+  void close();
+  //! Producer: return true if the consumer does not need more records.
+  bool isStopped() const {
+    return header->stopped.load() != 0;
+  }
+
+  //! Consumer: wait for the next record and return a pointer to it.
+  /*!
+    The record remains valid until release() is called. Return NULL
+    if the producer has closed the ring and no records are left.
+    */
+  const char* read(size_t& n);
+  //! Consumer: free the space of the record returned by read().
+  void release();
+  //! Consumer: notify the producer that no more records are needed.
+  void stop();
+};
+
+//! Read-only stream buffer over a memory region, without copying it.
+class MemoryStreamBuf : public std::streambuf
+{
+ protected:
+  //! Move the get pointer, as needed by seekg() and tellg().
+  pos_type seekoff(off_type                off,
+                   std::ios_base::seekdir  dir,
+                   std::ios_base::openmode which);
+  //! Move the get pointer to an absolute position.
+  pos_type seekpos(pos_type pos, std::ios_base::openmode which);
+
+ public:
+  //! Make the n bytes at p available for reading.
+  MemoryStreamBuf(const char* p, size_t n) {
+    char* q = const_cast<char*>(p);
+    setg(q, q, q + n);
+  }
+};
+
+#endif // __MEASURE_SHMRING_H
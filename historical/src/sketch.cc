@@ -0,0 +1,232 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: sketch.cc
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           body of the Sketch class
+*/
+
+#include <sketch.h>
+
+#include <cfloat>
+#include <cmath>
+
+Sketch::Sketch(double a)
+    : Object("Sketch")
+    , accuracy(a)
+    , logGamma(0)
+    , offset(0)
+    , zero(0)
+    , count(0)
+    , sum(0) {
+  if (!(a >= SKETCH_MIN_ACCURACY && a < 1))
+    throw *this;
+  logGamma = log((1 + a) / (1 - a));
+}
+
+int Sketch::key(double x) const {
+  if (x > DBL_MAX)
+    x = DBL_MAX;
+  return (int)ceil(log(x) / logGamma);
+}
+
+double Sketch::value(int key) const {
+  // in the middle of the bucket, in relative terms
+  return 2.0 * exp(key * logGamma) / (1.0 + exp(logGamma));
+}
+
+void Sketch::collapse(int low) {
+  const unsigned int drop =
+      (unsigned int)(low - offset) < counts.size() ? low - offset
+                                                   : counts.size();
+  double folded = 0; // count of the buckets merged
+  for (unsigned int i = 0; i < drop; i++)
+    folded += counts[i];
+  counts.erase(counts.begin(), counts.begin() + drop);
+  offset = low;
+  if (counts.empty())
+    counts.push_back(0);
+  counts[0] += folded;
+}
+
+unsigned int Sketch::locate(int key) {
+  if (counts.empty()) {
+    offset = key;
+    counts.push_back(0);
+    return 0;
+  }
+
+  const int high = offset + (int)counts.size() - 1; // highest key
+  if (key > high) {
+    // make room for the new highest bucket, merging the lowest ones
+    // first so that the number of buckets never exceeds the maximum
+    const int low = key - SKETCH_MAX_BUCKETS + 1;
+    if (low > offset)
+      collapse(low);
+    counts.resize(key - offset + 1, 0);
+  } else if (key < offset) {
+    // values below the lowest bucket kept go into it
+    if (key < high - SKETCH_MAX_BUCKETS + 1)
+      key = high - SKETCH_MAX_BUCKETS + 1;
+    if (key < offset) {
+      counts.insert(counts.begin(), offset - key, 0);
+      offset = key;
+    }
+  }
+  return key - offset;
+}
+
+void Sketch::add(double x) {
+  count++;
+  sum += x;
+  if (x > 0)
+    counts[locate(key(x))]++;
+  else
+    zero++;
+}
+
+void Sketch::merge(const Sketch& s) {
+  if (s.accuracy != accuracy)
+    throw *this;
+  zero += s.zero;
+  count += s.count;
+  sum += s.sum;
+  for (unsigned int i = 0; i < s.counts.size(); i++) {
+    if (s.counts[i] != 0)
+      counts[locate(s.offset + i)] += s.counts[i];
+  }
+}
+
+void Sketch::merge(double        s,
+                   double        z,
+                   unsigned int  n,
+                   const int*    keys,
+                   const double* values) {
+  zero += z;
+  count += z;
+  sum += s;
+  for (unsigned int i = 0; i < n; i++) {
+    if (i > 0 && keys[i] <= keys[i - 1])
+      throw *this;
+    counts[locate(keys[i])] += values[i];
+    count += values[i];
+  }
+}
+
+void Sketch::clear() {
+  counts.clear();
+  offset = 0;
+  zero   = 0;
+  count  = 0;
+  sum    = 0;
+}
+
+double Sketch::quantile(double q) const {
+  if (count <= 0)
+    return 0.0;
+
+  // the first bucket where the number of values exceeds the rank
+  const double rank       = (q < 0 ? 0 : q > 1 ? 1 : q) * (count - 1);
+  double       cumulative = zero;
+  if (cumulative > rank)
+    return 0.0;
+  for (unsigned int i = 0; i < counts.size(); i++) {
+    cumulative += counts[i];
+    if (counts[i] != 0 && cumulative > rank)
+      return value(offset + i);
+  }
+
+  // only because of rounding errors
+  for (unsigned int i = counts.size(); i > 0; i--) {
+    if (counts[i - 1] != 0)
+      return value(offset + i - 1);
+  }
+  return 0.0;
+}
+
+void Sketch::buckets(std::vector<int>&    keys,
+                     std::vector<double>& values) const {
+  keys.clear();
+  values.clear();
+  for (unsigned int i = 0; i < counts.size(); i++) {
+    if (counts[i] != 0) {
+      keys.push_back(offset + i);
+      values.push_back(counts[i]);
+    }
+  }
+}
+
+void Sketch::encode(std::string& out) const {
+  std::vector<int>    keys;
+  std::vector<double> values;
+  buckets(keys, values);
+  const unsigned int n = keys.size();
+  out.append((const char*)&sum, sizeof(sum));
+  out.append((const char*)&zero, sizeof(zero));
+  out.append((const char*)&n, sizeof(n));
+  if (n > 0) {
+    out.append((const char*)&keys[0], n * sizeof(int));
+    out.append((const char*)&values[0], n * sizeof(double));
+  }
+}
+
+void Sketch::write(std::ostream& os) const {
+  std::string buf;
+  encode(buf);
+  os.write((const char*)&accuracy, sizeof(accuracy));
+  os.write(buf.data(), buf.size());
+}
+
+bool Sketch::read(std::istream& is) {
+  double       a; // accuracy
+  double       s; // sum
+  double       z; // count of the values not greater than 0
+  unsigned int n; // number of buckets
+  is.read((char*)&a, sizeof(a));
+  is.read((char*)&s, sizeof(s));
+  is.read((char*)&z, sizeof(z));
+  is.read((char*)&n, sizeof(n));
+  if (is.fail() || !(a >= SKETCH_MIN_ACCURACY && a < 1))
+    return false;
+  std::vector<int>    keys(n);
+  std::vector<double> values(n);
+  if (n > 0) {
+    is.read((char*)&keys[0], n * sizeof(int));
+    is.read((char*)&values[0], n * sizeof(double));
+  }
+  if (is.fail())
+    return false;
+
+  Sketch sketch(a);
+  try {
+    sketch.merge(s, z, n, keys.empty() ? 0 : &keys[0],
+                 values.empty() ? 0 : &values[0]);
+  } catch (const Object&) {
+    return false;
+  }
+  *this = sketch;
+  return true;
+}
@@ -0,0 +1,152 @@
+/*
+ *  Copyright (C) 2006 Dip. Ing. dell'Informazione, University of Pisa, Italy
+ *  http://info.iet.unipi.it/~cng/ns2measure/ns2measure.html
+ *
+ *  This program is free software; you can redistribute it and/or modify
+ *  it under the terms of the GNU General Public License as published by
+ *  the Free Software Foundation; either version 2 of the License, or
+ *  (at your option) any later version.
+ *
+ *  This program is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU General Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License
+ *  along with this program; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA, USA
+ */
+
+/**
+   project: measure
+   filename: sketch.h
+        author: C. Cicconetti <c.cicconetti@iet.unipi.it>
+        year: 2006
+   affiliation:
+      Dipartimento di Ingegneria dell'Informazione
+           University of Pisa, Italy
+   description:
+           mergeable quantile sketch with logarithmic buckets
+*/
+
+#ifndef __MEASURE_SKETCH_H
+#define __MEASURE_SKETCH_H
+
+#include <config.h>
+#include <object.h>
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+//! Mergeable quantile sketch, with logarithmic buckets.
+/*!
+  The value x > 0 is counted in the bucket with key k such that
+  gamma^(k-1) < x <= gamma^k, where gamma = (1 + a) / (1 - a), and
+  the quantiles are reported as the value in the middle of the bucket,
+  hence their relative error is at most a, the accuracy. Values not
+  greater than 0 are counted together, and reported as 0.
+
+  Unlike the histograms of DstMeasure, neither the range of the values
+  nor the bin size must be known in advance, and two sketches with the
+  same accuracy are merged by adding the counts of their buckets.
+
+  At most SKETCH_MAX_BUCKETS buckets are kept, from the highest key
+  down: if more are needed, the lowest buckets are merged, which only
+  affects the accuracy of the lowest quantiles.
+  */
+class Sketch : public Object
+{
+  //! Relative accuracy of the quantiles.
+  double accuracy;
+  //! Logarithm of the ratio between the bounds of a bucket.
+  double logGamma;
+  //! Key of the first bucket in counts.
+  int offset;
+  //! Counts of the buckets, from offset on.
+  std::vector<double> counts;
+  //! Count of the values not greater than 0.
+  double zero;
+  //! Number of values.
+  double count;
+  //! Sum of the values.
+  double sum;
+
+  //! Return the position in counts of a bucket, adding it if needed.
+  unsigned int locate(int key);
+  //! Merge all the buckets below low into it.
+  void collapse(int low);
+
+ public:
+  //! Create an empty sketch with a given relative accuracy.
+  /*!
+    An exception is thrown unless the accuracy is at least
+    SKETCH_MIN_ACCURACY and smaller than 1.
+    */
+  Sketch(double accuracy = SKETCH_ACCURACY);
+  //! Do nothing.
+  ~Sketch() {
+  }
+
+  //! Add a value.
+  void add(double x);
+  //! Add the content of another sketch, with the same accuracy.
+  void merge(const Sketch& s);
+  //! Add the content of an encoded sketch, see encode().
+  /*!
+    The keys must be in increasing order.
+    */
+  void merge(double        sum,
+             double        zero,
+             unsigned int  n,
+             const int*    keys,
+             const double* counts);
+  //! Remove all the values.
+  void clear();
+
+  //! Return the relative accuracy.
+  double getAccuracy() const {
+    return accuracy;
+  }
+  //! Return the number of values.
+  double getCount() const {
+    return count;
+  }
+  //! Return the mean of the values, 0 if there are none.
+  double mean() const {
+    return count > 0 ? sum / count : 0.0;
+  }
+  //! Return the quantile q, in [0, 1], or 0 if there are no values.
+  double quantile(double q) const;
+  //! Return the value reported for the bucket with a given key.
+  double value(int key) const;
+  //! Return the key of the bucket of a value greater than 0.
+  int key(double x) const;
+
+  //! Return the non-empty buckets, by increasing key.
+  void buckets(std::vector<int>& keys, std::vector<double>& values) const;
+  //! Return the sum of the values.
+  double getSum() const {
+    return sum;
+  }
+  //! Return the count of the values not greater than 0.
+  double getZero() const {
+    return zero;
+  }
+
+  //! Append the sketch to a buffer, as in the protocol of input.h.
+  /*!
+    DBL sum, DBL count of values not greater than 0, UIN number of
+    non-empty buckets n, then n INT keys and n DBL counts.
+    */
+  void encode(std::string& out) const;
+  //! Write the sketch, including its accuracy, to a binary stream.
+  void write(std::ostream& os) const;
+  //! Read a sketch written by write(), replacing the current one.
+  /*!
+    Return false on premature end of file.
+    */
+  bool read(std::istream& is);
+};
+
+#endif // __MEASURE_SKETCH_H
@@ -61,7 +61,7 @@ double Stat::t_student(double cl, int df) {
       return t_table[df - 1][1];
   } else if (cl <= .975) {
     if (df > 30)
-      return -1; // TODO: check this value for df = infty
+      return 2.241;
     else
       return t_table[df - 1][2];
   } else {
@@ -114,6 +114,20 @@ double Stat::confInterval(bool&                        valid,
   }
   variance /= n - 1.0;
 
+  return confInterval(valid, n, variance, cl);
+}
+
+double Stat::confInterval(bool&        valid,
+                          unsigned int n,
+                          double       variance,
+                          double       cl) {
+  // validate input
+  if ((cl > 0 && cl < 1 && n <= 1) || (cl == 2 && n <= 1)) {
+    valid = false;
+    return -1.0;
+  }
+  valid = true;
+
   // return the half confidence interval
   if (cl == 2)
     return sqrt(variance) / 2.0;
@@ -68,6 +68,13 @@ class Stat : public Object
     */
   static double
   confInterval(bool& valid, const std::vector<sample_t>& samples, double cl);
+  //! Return the confidence interval from the number of samples and variance.
+  /*!
+    The validity bit is as above. The variance is the sample variance,
+    i.e., the sum of the squared deviations from the mean divided by n-1.
+    */
+  static double
+  confInterval(bool& valid, unsigned int n, double variance, double cl);
   //! Return the mean of a set of samples.
   /*!
     The validity bit is false if the number of samples is zero.